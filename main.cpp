@@ -1,19 +1,211 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <list>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include <glob.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Вид обращения к иерархии кешей
+enum class AccessKind {
+    Load,
+    Store,
+    Atomic,    // атомарное чтение-модификация-запись
+    Prefetch,  // программная предвыборка
+    NtStore,   // некешируемая (потоковая) запись
+    Flush,     // clflush: линия снимается со всех уровней
+    Clwb,      // clwb: грязная линия записывается в память и остается в кеше
+    Ifetch,    // выборка инструкций по PC
+    PageWalk,  // чтение элемента таблицы страниц обходчиком
+    Count
+};
+
+const char* access_kind_name(AccessKind kind) {
+    static const char* const names[] = {"load", "store", "atomic", "prefetch", "nt_store", "flush", "clwb",
+                                        "ifetch", "page_walk"};
+    return names[static_cast<size_t>(kind)];
+}
+
+// Вид по первой букве типа записи текстовой трассы (l, s, a, p, n, f, w, i);
+// неизвестные типы считаются чтением
+AccessKind access_kind_from_letter(char letter) {
+    switch (letter) {
+    case 's': return AccessKind::Store;
+    case 'a': return AccessKind::Atomic;
+    case 'p': return AccessKind::Prefetch;
+    case 'n': return AccessKind::NtStore;
+    case 'f': return AccessKind::Flush;
+    case 'w': return AccessKind::Clwb;
+    case 'i': return AccessKind::Ifetch;
+    default: return AccessKind::Load;
+    }
+}
+
 struct LogEntry {
-    std::string access_type;
+    AccessKind kind;
+    uint32_t size;            // байт, 0 - неизвестно
     uint64_t address;
     uint64_t thread_id;
     uint64_t return_address;
+    uint64_t timestamp;       // такт или счетчик инструкций потока, 0 - нет
+
+    LogEntry() : kind(AccessKind::Load), size(0), address(0), thread_id(0), return_address(0), timestamp(0) {}
+};
+
+
+// Гистограмма с логарифмическими корзинами:
+// корзина 0 - значение 0, корзина i - значения из [2^(i-1), 2^i - 1]
+class Histogram {
+private:
+    std::vector<uint64_t> buckets;
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max_value;
+
+public:
+    Histogram() : buckets(65, 0), count(0), sum(0), max_value(0) {}
+
+    void add(uint64_t value) {
+        size_t bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+        buckets[bucket]++;
+        count++;
+        sum += value;
+        if (value > max_value) {
+            max_value = value;
+        }
+    }
+
+    void merge(const Histogram& other) {
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            buckets[i] += other.buckets[i];
+        }
+        count += other.count;
+        sum += other.sum;
+        if (other.max_value > max_value) {
+            max_value = other.max_value;
+        }
+    }
+
+    uint64_t total() const { return count; }
+    uint64_t get_sum() const { return sum; }
+    uint64_t get_max() const { return max_value; }
+    double mean() const { return count ? static_cast<double>(sum) / count : 0.0; }
+
+    // Корзины до последней непустой включительно
+    std::vector<uint64_t> used_buckets() const {
+        size_t last = buckets.size();
+        while (last > 0 && buckets[last - 1] == 0) {
+            --last;
+        }
+        return std::vector<uint64_t>(buckets.begin(), buckets.begin() + last);
+    }
+};
+
+
+// Простейший потоковый писатель JSON без внешних зависимостей
+class JsonWriter {
+private:
+    std::ostream& out;
+    std::vector<bool> first_in_scope;
+
+    void separator() {
+        if (!first_in_scope.empty()) {
+            if (!first_in_scope.back()) {
+                out << ",";
+            }
+            first_in_scope.back() = false;
+            out << "\n" << std::string(first_in_scope.size() * 2, ' ');
+        }
+    }
+
+    void key(const std::string& name) {
+        separator();
+        write_string(name);
+        out << ": ";
+    }
+
+    void write_string(const std::string& text) {
+        out << '"';
+        for (char c : text) {
+            switch (c) {
+                case '"': out << "\\\""; break;
+                case '\\': out << "\\\\"; break;
+                case '\n': out << "\\n"; break;
+                case '\t': out << "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                            << static_cast<int>(c) << std::dec << std::setfill(' ');
+                    } else {
+                        out << c;
+                    }
+            }
+        }
+        out << '"';
+    }
+
+    void close(char bracket) {
+        bool empty = first_in_scope.back();
+        first_in_scope.pop_back();
+        if (!empty) {
+            out << "\n" << std::string(first_in_scope.size() * 2, ' ');
+        }
+        out << bracket;
+    }
+
+public:
+    explicit JsonWriter(std::ostream& stream) : out(stream) {
+        out << std::setprecision(10);
+    }
+
+    void begin_object() { separator(); out << "{"; first_in_scope.push_back(true); }
+    void begin_object(const std::string& name) { key(name); out << "{"; first_in_scope.push_back(true); }
+    void end_object() { close('}'); }
+
+    void begin_array(const std::string& name) { key(name); out << "["; first_in_scope.push_back(true); }
+    void end_array() { close(']'); }
+
+    void value(const std::string& name, uint64_t number) { key(name); out << number; }
+    void value(const std::string& name, double number) { key(name); out << (std::isfinite(number) ? number : 0.0); }
+    void value(const std::string& name, bool flag) { key(name); out << (flag ? "true" : "false"); }
+    void value(const std::string& name, const std::string& text) { key(name); write_string(text); }
+
+    void element(uint64_t number) { separator(); out << number; }
+
+    void histogram(const std::string& name, const Histogram& hist) {
+        begin_object(name);
+        value("count", hist.total());
+        value("sum", hist.get_sum());
+        value("max", hist.get_max());
+        value("mean", hist.mean());
+        begin_array("log2_buckets");
+        for (uint64_t bucket : hist.used_buckets()) {
+            element(bucket);
+        }
+        end_array();
+        end_object();
+    }
 };
 
 
@@ -21,203 +213,5979 @@ struct CacheLine {
     uint64_t tag;
     bool valid;
     uint64_t last_access_time;
+    uint64_t insert_time;
+    uint64_t last_hit_time;
+    uint64_t hit_count;
+    uint16_t owner;  // группа, загрузившая линию (для разделения путей)
+    bool dirty;
     
-    CacheLine() : tag(0), valid(false), last_access_time(0) {}
+    CacheLine() : tag(0), valid(false), last_access_time(0), insert_time(0),
+                  last_hit_time(0), hit_count(0), owner(0), dirty(false) {}
 };
 
 
-class Cache {
-private:
-    size_t size;           // размер кэша в байтах
-    size_t line_size;      // размер кэш-линии в байтах
-    size_t associativity;  // ассоциативность
-    bool is_shared;        // общий или приватный
-    size_t num_sets;       // количество сетов
-    
-    std::vector<std::vector<CacheLine> > sets;
-    uint64_t access_counter;
-    
-    // Статистика
+struct CacheStats {
     size_t hits;
     size_t misses;
+    size_t evictions;
+    size_t bypasses;                   // промахи, при которых линия не была размещена
+    size_t writebacks;                 // вытесненные грязные линии
+    size_t dead_evictions;             // вытеснены, не получив ни одного попадания
+    size_t filtered;                   // попадания в последнюю использованную линию (быстрый путь L0)
+    Histogram eviction_age;            // время жизни вытесненной линии (в обращениях к кешу)
+    Histogram dead_time;               // время от последнего использования до вытеснения
+    Histogram hits_before_eviction;
 
-public:
-    Cache() : size(0), line_size(0), associativity(0), 
-            is_shared(false), num_sets(0), access_counter(0), 
-            hits(0), misses(0) {
+    CacheStats() : hits(0), misses(0), evictions(0), bypasses(0), writebacks(0), dead_evictions(0), filtered(0) {}
+
+    void merge(const CacheStats& other) {
+        hits += other.hits;
+        misses += other.misses;
+        evictions += other.evictions;
+        bypasses += other.bypasses;
+        writebacks += other.writebacks;
+        dead_evictions += other.dead_evictions;
+        filtered += other.filtered;
+        eviction_age.merge(other.eviction_age);
+        dead_time.merge(other.dead_time);
+        hits_before_eviction.merge(other.hits_before_eviction);
     }
 
-    Cache(size_t size_bytes, size_t line_size_bytes, size_t associativity, bool shared) 
-        : size(size_bytes), line_size(line_size_bytes), associativity(associativity), 
-          is_shared(shared), access_counter(0), hits(0), misses(0) {
-        
-        num_sets = size / (line_size * associativity);
-        sets.resize(num_sets, std::vector<CacheLine>(associativity));
+    // Доля вытесненных линий, к которым ни разу не обратились после загрузки
+    double dead_block_ratio() const {
+        return evictions ? static_cast<double>(dead_evictions) / evictions : 0.0;
     }
 
+    // Доля времени жизни линий, в течение которой они уже были мертвы,
+    // то есть средняя доля емкости кеша, занятая мертвыми данными
+    double dead_time_fraction() const {
+        return eviction_age.get_sum() ? static_cast<double>(dead_time.get_sum()) / eviction_age.get_sum() : 0.0;
+    }
 
-    bool access(uint64_t address, bool count_cache = true) {
-        const uint64_t offset_bits = log2(line_size);
-        const uint64_t index_bits = log2(num_sets);
-        
-        const uint64_t set_mask = (1ULL << index_bits) - 1;
-        
-        uint64_t set_index = (address >> offset_bits) & set_mask;
-        uint64_t tag = address >> (offset_bits + index_bits);
-        
-        auto& set = sets[set_index];
-        for (auto& line : set) {
-            if (line.valid && line.tag == tag) {
-                line.last_access_time = ++access_counter;
-                if (count_cache) {
-                    hits++;
-                }
-                return true;  // cache hit
-            }
+    double hit_rate() const {
+        return hits + misses ? static_cast<double>(hits) / (hits + misses) : 0.0;
+    }
+
+    double bypass_rate() const {
+        return misses ? static_cast<double>(bypasses) / misses : 0.0;
+    }
+};
+
+
+// Политика допуска линий в кеш при промахе
+enum class AdmissionPolicy {
+    None,           // всегда размещаем линию в MRU-позиции (обычный LRU)
+    Probabilistic,  // размещаем с вероятностью admission_probability, иначе обходим кеш
+    Bip,            // bimodal insertion: в MRU с вероятностью bip_epsilon, иначе в LRU-позицию
+    Sdbp,           // обход при предсказании мертвой линии (sampling dead-block predictor по PC)
+    Perceptron      // обход при предсказании отсутствия повторного использования (perceptron)
+};
+
+bool parse_admission_policy(const std::string& name, AdmissionPolicy& out) {
+    static const std::pair<const char*, AdmissionPolicy> names[] = {
+        {"none", AdmissionPolicy::None},
+        {"probabilistic", AdmissionPolicy::Probabilistic},
+        {"bip", AdmissionPolicy::Bip},
+        {"sdbp", AdmissionPolicy::Sdbp},
+        {"perceptron", AdmissionPolicy::Perceptron},
+    };
+    for (const auto& it : names) {
+        if (name == it.first) {
+            out = it.second;
+            return true;
         }
+    }
+    return false;
+}
 
-        // Cache miss
-        if (count_cache) {
-            misses++;
+
+// Разделение путей общего кеша между группами потоков
+enum class PartitionMode {
+    None,    // без разделения
+    Static,  // фиксированные маски путей для каждой группы (как Intel CAT)
+    Ucp      // utility-based partitioning: маски пересчитываются в конце каждой эпохи
+};
+
+bool parse_partition_mode(const std::string& name, PartitionMode& out) {
+    static const std::pair<const char*, PartitionMode> names[] = {
+        {"none", PartitionMode::None},
+        {"static", PartitionMode::Static},
+        {"ucp", PartitionMode::Ucp},
+    };
+    for (const auto& it : names) {
+        if (name == it.first) {
+            out = it.second;
+            return true;
         }
-        
-        CacheLine* replacement_line = nullptr;
-        for (auto& line : set) {
-            if (!line.valid) {
-                replacement_line = &line;
-                break;
+    }
+    return false;
+}
+
+
+// Функция выбора сета по адресу линии
+enum class IndexFunction {
+    Modulo,  // младшие биты адреса линии
+    Xor,     // XOR-свертка всего адреса линии до ширины индекса
+    Prime,   // остаток от деления на наибольшее простое число, не превосходящее число сетов
+    Skewed   // skewed-associative: у каждого пути своя хеш-функция индекса
+};
+
+bool parse_index_function(const std::string& name, IndexFunction& out) {
+    static const std::pair<const char*, IndexFunction> names[] = {
+        {"modulo", IndexFunction::Modulo},
+        {"xor", IndexFunction::Xor},
+        {"prime", IndexFunction::Prime},
+        {"skewed", IndexFunction::Skewed},
+    };
+    for (const auto& it : names) {
+        if (name == it.first) {
+            out = it.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Страницы хоста под арену состояния модели
+enum class HugePages {
+    None,         // обычные 4 КБ страницы
+    Transparent,  // madvise(MADV_HUGEPAGE): ядро собирает области в 2 МБ страницы (THP)
+    Explicit      // MAP_HUGETLB из заранее выделенного пула hugetlbfs, при нехватке - THP
+};
+
+bool parse_huge_pages(const std::string& name, HugePages& out) {
+    static const std::pair<const char*, HugePages> names[] = {
+        {"none", HugePages::None},
+        {"transparent", HugePages::Transparent},
+        {"explicit", HugePages::Explicit},
+    };
+    for (const auto& it : names) {
+        if (name == it.first) {
+            out = it.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* huge_pages_name(HugePages mode) {
+    static const char* const names[] = {"none", "transparent", "explicit"};
+    return names[static_cast<size_t>(mode)];
+}
+
+
+// Арена состояния модели: память берется у ОС областями по REGION_BYTES,
+// выровненными на 2 МБ, и раздается сдвигом указателя, так что линии всех
+// кешей прогона лежат плотно на небольшом числе больших страниц. Отдельного
+// освобождения нет: reset() разом возвращает всю память для следующего
+// прогона, не отдавая ее ОС. Память после reset() не обнулена - объекты
+// создаются в allocate_array(). Не потокобезопасна: одна арена на прогон
+class Arena {
+private:
+    struct Region {
+        char* base;
+        size_t size;
+        size_t used;
+    };
+
+    static const size_t REGION_BYTES = size_t(64) << 20;
+    static const size_t HUGE_PAGE_BYTES = size_t(2) << 20;
+
+    HugePages huge_pages;
+    std::vector<Region> regions;
+    size_t current;  // область, из которой идет раздача
+
+    // Резервирует область не меньше bytes; физические страницы появляются при первом касании
+    Region map_region(size_t bytes) {
+        const size_t wanted = bytes > REGION_BYTES ? bytes : REGION_BYTES;
+        const size_t size = (wanted + HUGE_PAGE_BYTES - 1) / HUGE_PAGE_BYTES * HUGE_PAGE_BYTES;
+#ifdef MAP_HUGETLB
+        if (huge_pages == HugePages::Explicit) {
+            // Без MAP_NORESERVE: страницы пула резервируются сразу, и нехватка
+            // видна здесь, а не как SIGBUS при первом касании
+            void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (base != MAP_FAILED) {
+                return Region{static_cast<char*>(base), size, 0};
             }
+            std::cerr << "Explicit huge pages unavailable, falling back to transparent huge pages\n";
+            huge_pages = HugePages::Transparent;
+        }
+#endif
+        // Лишние 2 МБ, чтобы выровнять начало; неровные края сразу возвращаются ОС
+        void* mapped = mmap(nullptr, size + HUGE_PAGE_BYTES, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        char* raw = static_cast<char*>(mapped);
+        char* base = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(raw) + HUGE_PAGE_BYTES - 1) &
+                                             ~uintptr_t(HUGE_PAGE_BYTES - 1));
+        if (base != raw) {
+            munmap(raw, base - raw);
         }
+        munmap(base + size, raw + HUGE_PAGE_BYTES - base);
+#ifdef MADV_HUGEPAGE
+        if (huge_pages == HugePages::Transparent) {
+            madvise(base, size, MADV_HUGEPAGE);
+        }
+#endif
+        return Region{base, size, 0};
+    }
 
-        // LRU
-        if (!replacement_line) {
-            uint64_t oldest_time = UINT64_MAX;
-            for (auto& line : set) {
-                if (line.last_access_time < oldest_time) {
-                    oldest_time = line.last_access_time;
-                    replacement_line = &line;
-                }
+public:
+    explicit Arena(HugePages huge_pages = HugePages::Transparent) : huge_pages(huge_pages), current(0) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena() {
+        for (const Region& region : regions) {
+            munmap(region.base, region.size);
+        }
+    }
+
+    // bytes байт, выровненных на alignment (степень двойки, не больше 2 МБ)
+    void* allocate(size_t bytes, size_t alignment = 64) {
+        for (; current < regions.size(); ++current) {
+            Region& region = regions[current];
+            const size_t offset = (region.used + alignment - 1) & ~(alignment - 1);
+            if (offset + bytes <= region.size) {
+                region.used = offset + bytes;
+                return region.base + offset;
             }
         }
+        regions.push_back(map_region(bytes));
+        regions.back().used = bytes;
+        return regions.back().base;
+    }
 
-        replacement_line->valid = true;
-        replacement_line->tag = tag;
-        replacement_line->last_access_time = ++access_counter;
-        
-        return false;  // cache miss
+    // Массив из count объектов T, созданных конструктором по умолчанию
+    template <typename T>
+    T* allocate_array(size_t count) {
+        T* items = static_cast<T*>(allocate(count * sizeof(T), std::max<size_t>(alignof(T), 64)));
+        std::uninitialized_fill_n(items, count, T());
+        return items;
     }
 
-    void get_statistics(size_t& out_hits, size_t& out_misses) const {
-        out_hits = hits;
-        out_misses = misses;
+    // Вся выданная память снова свободна; области остаются за ареной.
+    // Указатели, выданные до reset(), больше не действительны
+    void reset() {
+        for (Region& region : regions) {
+            region.used = 0;
+        }
+        current = 0;
+    }
+
+    size_t region_count() const { return regions.size(); }
+
+    size_t reserved_bytes() const {
+        size_t total = 0;
+        for (const Region& region : regions) {
+            total += region.size;
+        }
+        return total;
+    }
+
+    size_t used_bytes() const {
+        size_t total = 0;
+        for (const Region& region : regions) {
+            total += region.used;
+        }
+        return total;
     }
+
+    // Режим страниц с учетом отката Explicit -> Transparent
+    HugePages huge_page_mode() const { return huge_pages; }
 };
 
 
-class CacheHierarchy {
+// Настройки политик отдельного уровня кеша
+struct CacheOptions {
+    AdmissionPolicy admission = AdmissionPolicy::None;
+    double admission_probability = 0.5;
+    double bip_epsilon = 1.0 / 32;
+    uint64_t seed = 1;
+
+    PartitionMode partition = PartitionMode::None;
+    size_t partition_groups = 1;
+    std::vector<uint64_t> way_masks;   // маска путей для каждой группы (Static, начальная для Ucp)
+    uint64_t partition_epoch = 100000; // длина эпохи в учитываемых обращениях к кешу
+
+    IndexFunction index_function = IndexFunction::Modulo;
+    bool set_heatmap = false;          // считать обращения и промахи по каждому сету
+    bool same_line_filter = false;     // повтор обращения к последней линии минует поиск по тегам
+    bool virtual_index = false;        // VIPT: сет выбирается по виртуальному адресу, в теге весь физический адрес линии
+    Arena* arena = nullptr;            // откуда брать линии; nullptr - собственная арена кеша
+};
+
+
+// Предсказатель мертвых при загрузке линий. Обучается на сэмплере - отдельном
+// теговом массиве для небольшой выборки сетов: попадание в сэмплер означает,
+// что линия была переиспользована, вытеснение из сэмплера - что она умерла.
+//
+// SDBP (Khan et al.): три таблицы 2-битных счетчиков, индексируемые разными
+// хешами PC последнего обращения; линия мертва, если сумма >= 8.
+// Perceptron (Teran et al.): шесть таблиц весов [-32, 31], индексируемых
+// признаками (последние PC и биты тега); линия мертва, если сумма >= 3,
+// обучение только при ошибке или неуверенном ответе (|сумма| < 74).
+class ReusePredictor {
 private:
-    std::map<uint64_t, Cache> l1_caches;  // по одному на поток
-    Cache l2_cache;
-    Cache l3_cache;
+    static const size_t MAX_FEATURES = 6;
 
-    size_t l1_size;
-    size_t l1_line_size;
-    size_t l1_associativity;
+    struct SamplerEntry {
+        bool valid;
+        uint16_t partial_tag;
+        uint64_t last_access;
+        int32_t yout;
+        uint16_t index[MAX_FEATURES];
 
-public:
-    CacheHierarchy(
-        size_t num_cores,
-        size_t l1_size, size_t l1_line_size, size_t l1_associativity,
-        size_t l2_size, size_t l2_line_size, size_t l2_associativity,
-        size_t l3_size, size_t l3_line_size, size_t l3_associativity
-    ) : l2_cache(l2_size, l2_line_size, l2_associativity, true),
-        l3_cache(l3_size, l3_line_size, l3_associativity, true),
-        l1_size(l1_size), l1_line_size(l1_line_size), l1_associativity(l1_associativity) {
+        SamplerEntry() : valid(false), partial_tag(0), last_access(0), yout(0), index() {}
+    };
+
+    AdmissionPolicy kind;
+    size_t sample_stride;  // в сэмплер попадает каждый sample_stride-й сет
+    size_t num_features;
+    size_t table_size;
+    int counter_min, counter_max;
+    int threshold;
+    int training_threshold;
+
+    std::vector<std::vector<SamplerEntry> > sampler;
+    std::vector<std::vector<int8_t> > tables;
+    uint64_t pc_history[3];
+    uint64_t sampler_clock;
+    uint16_t features[MAX_FEATURES];  // индексы признаков текущего обращения (prepare)
+
+    static uint64_t mix(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdULL;
+        value ^= value >> 33;
+        return value;
     }
 
-    void access(uint64_t address, uint64_t thread_id) {
-        // Пробуем L1 // Берем L1-data кеш, L1-instruction не интересует
-        // Предполагаем, что каждый поток на отдельном ядре
-        if (l1_caches.find(thread_id) == l1_caches.end()) {
-            l1_caches[thread_id] = std::move(Cache(l1_size, l1_line_size, l1_associativity, false));
+    void compute_features(uint64_t pc, uint64_t tag, uint16_t* index) const {
+        if (kind == AdmissionPolicy::Sdbp) {
+            uint64_t signature = mix(pc) & 0x7fff;
+            for (size_t i = 0; i < num_features; ++i) {
+                index[i] = mix(signature * (2 * i + 1) + i) % table_size;
+            }
+            return;
         }
+        const uint64_t features[MAX_FEATURES] = {
+            pc >> 2,
+            pc_history[0] >> 1,
+            pc_history[1] >> 2,
+            (pc >> 4) ^ pc_history[0],
+            tag >> 4,
+            tag >> 7,
+        };
+        for (size_t i = 0; i < num_features; ++i) {
+            index[i] = mix(features[i] + i * 0x9e3779b97f4a7c15ULL) % table_size;
+        }
+    }
 
-        bool l1_hit = l1_caches[thread_id].access(address);
-        if (l1_hit) return;
+    int sum(const uint16_t* index) const {
+        int total = 0;
+        for (size_t i = 0; i < num_features; ++i) {
+            total += tables[i][index[i]];
+        }
+        return total;
+    }
 
-        // При промахе L1 пробуем L2
-        bool l2_hit = l2_cache.access(address);
-        if (l2_hit) {
-            // При попадании в L2 подгружаем также в L1
-            l1_caches[thread_id].access(address, false);
+    void train(const SamplerEntry& entry, bool dead) {
+        bool mispredicted = (entry.yout >= threshold) != dead;
+        if (kind == AdmissionPolicy::Perceptron && !mispredicted && std::abs(entry.yout) >= training_threshold) {
             return;
         }
-
-        // При промахе L2 пробуем L3
-        bool l3_hit = l3_cache.access(address, thread_id);
-        
-        // При промахе L3 данные подгружаются из памяти во все уровни кэша
-        l2_cache.access(address, false);
-        l1_caches[thread_id].access(address, false);
+        for (size_t i = 0; i < num_features; ++i) {
+            int8_t& weight = tables[i][entry.index[i]];
+            if (dead && weight < counter_max) {
+                weight++;
+            } else if (!dead && weight > counter_min) {
+                weight--;
+            }
+        }
     }
 
-    void print_statistics() {
-        size_t l1_hits = 0, l1_misses = 0;
-        size_t l2_hits = 0, l2_misses = 0;
-        size_t l3_hits = 0, l3_misses = 0;
+public:
+    ReusePredictor() : kind(AdmissionPolicy::None), sample_stride(1), num_features(0), table_size(0),
+                       counter_min(0), counter_max(0), threshold(0), training_threshold(0),
+                       pc_history(), sampler_clock(0), features() {}
 
-        for (const auto& l1 : l1_caches) {
-            size_t hits, misses;
-            l1.second.get_statistics(hits, misses);
-            l1_hits += hits;
-            l1_misses += misses;
+    ReusePredictor(AdmissionPolicy kind, size_t num_sets, size_t associativity)
+        : kind(kind), pc_history(), sampler_clock(0), features() {
+        if (kind == AdmissionPolicy::Sdbp) {
+            num_features = 3;
+            table_size = 4096;
+            counter_min = 0;
+            counter_max = 3;
+            threshold = 8;
+            training_threshold = 0;
+        } else {
+            num_features = MAX_FEATURES;
+            table_size = 256;
+            counter_min = -32;
+            counter_max = 31;
+            threshold = 3;
+            training_threshold = 74;
         }
+        const size_t sampled_sets = std::min<size_t>(64, std::max<size_t>(num_sets, 1));
+        sample_stride = std::max<size_t>(num_sets / sampled_sets, 1);
+        sampler.assign(sampled_sets, std::vector<SamplerEntry>(std::min<size_t>(associativity, 16)));
+        tables.assign(num_features, std::vector<int8_t>(table_size, 0));
+    }
 
-        l2_cache.get_statistics(l2_hits, l2_misses);
-        l3_cache.get_statistics(l3_hits, l3_misses);
+    bool enabled() const { return kind == AdmissionPolicy::Sdbp || kind == AdmissionPolicy::Perceptron; }
 
-        std::cout << "Cache Statistics:\n"
-                  << "L1: " << l1_hits << " hits, " << l1_misses << " misses\n"
-                  << "L2: " << l2_hits << " hits, " << l2_misses << " misses\n"
-                  << "L3: " << l3_hits << " hits, " << l3_misses << " misses\n";
+    // Вызывается в начале каждого обращения к кешу: признаки считаются один раз,
+    // до сдвига истории PC в observe(), и общие для обучения и предсказания
+    void prepare(uint64_t pc, uint64_t tag) {
+        compute_features(pc, tag, features);
+    }
+
+    // Предсказание для обращения, подготовленного prepare()
+    bool predict_dead() const {
+        return sum(features) >= threshold;
+    }
+
+    // Вызывается для каждого учитываемого обращения к кешу после prepare()
+    void observe(size_t set_index, uint64_t tag, uint64_t pc) {
+        if (set_index % sample_stride == 0 && set_index / sample_stride < sampler.size()) {
+            auto& set = sampler[set_index / sample_stride];
+            uint16_t partial_tag = mix(tag) & 0xffff;
+
+            SamplerEntry* entry = nullptr;
+            for (auto& candidate : set) {
+                if (candidate.valid && candidate.partial_tag == partial_tag) {
+                    entry = &candidate;
+                    train(*entry, false);
+                    break;
+                }
+            }
+            if (!entry) {
+                entry = &set[0];
+                for (auto& candidate : set) {
+                    if (!candidate.valid) {
+                        entry = &candidate;
+                        break;
+                    }
+                    if (candidate.last_access < entry->last_access) {
+                        entry = &candidate;
+                    }
+                }
+                if (entry->valid) {
+                    train(*entry, true);
+                }
+            }
+
+            entry->valid = true;
+            entry->partial_tag = partial_tag;
+            entry->last_access = ++sampler_clock;
+            entry->yout = sum(features);
+            std::copy(features, features + num_features, entry->index);
+        }
+
+        pc_history[2] = pc_history[1];
+        pc_history[1] = pc_history[0];
+        pc_history[0] = pc;
     }
 };
 
 
-LogEntry parse_log_line(const std::string& line) {
-    LogEntry entry;
-    std::stringstream ss(line);
-    ss >> entry.access_type >> entry.address >> entry.thread_id >> entry.return_address;
-    return entry;
-}
+// UMON (Qureshi, Patt): для каждой группы - теневые теги выборки сетов с LRU-стеком
+// на всю ассоциативность. Попадание на позиции p стека означает, что группе
+// хватило бы p + 1 путей, так что по счетчикам позиций строится кривая полезности.
+class UtilityMonitor {
+private:
+    size_t associativity;
+    size_t sample_stride;
+    size_t sampled_sets;
+    // shadow_tags[group][sampled_set] - LRU-стек тегов, в начале самый свежий
+    std::vector<std::vector<std::vector<uint64_t> > > shadow_tags;
+    std::vector<std::vector<uint64_t> > position_hits;
 
-int main() {
-    // Можно промедилировать полностью ассоциативный кеш, подобрав нужную ассоциативность
-    CacheHierarchy cache_hierarchy(
-        78,                          // количество ядер
-        5 * 1024 * 1024,                 // L1 size (5 MiB)
-        64,                        // L1 line size
-        8,                         // L1 associativity
-        39 * 1024 * 1024,               // L2 size (39 MiB)
-        64,                        // L2 line size
-        8,                         // L2 associativity
-        6 * 1024 * 1024,          // L3 size (64 MiB)
-        64,                        // L3 line size
-        16                         // L3 associativity
-    );
-
-    std::ifstream input_file("memory_trace.log");
-    std::string line;
+    // Число попаданий группы, если бы ей было выделено ways путей
+    uint64_t utility(size_t group, size_t ways) const {
+        uint64_t total = 0;
+        for (size_t i = 0; i < ways && i < associativity; ++i) {
+            total += position_hits[group][i];
+        }
+        return total;
+    }
 
-    uint64_t i = 0; 
-    while (std::getline(input_file, line)) {
-        if (++i % 10000 == 0) {
-            std::cout << "Proccess " << i << " line" << std::endl;
+public:
+    UtilityMonitor() : associativity(0), sample_stride(1), sampled_sets(0) {}
+
+    UtilityMonitor(size_t num_groups, size_t num_sets, size_t associativity)
+        : associativity(associativity) {
+        sampled_sets = std::min<size_t>(32, std::max<size_t>(num_sets, 1));
+        sample_stride = std::max<size_t>(num_sets / sampled_sets, 1);
+        shadow_tags.assign(num_groups, std::vector<std::vector<uint64_t> >(sampled_sets));
+        position_hits.assign(num_groups, std::vector<uint64_t>(associativity, 0));
+    }
+
+    void observe(size_t group, size_t set_index, uint64_t tag) {
+        if (set_index % sample_stride != 0 || set_index / sample_stride >= sampled_sets) {
+            return;
+        }
+        auto& stack = shadow_tags[group][set_index / sample_stride];
+        auto it = std::find(stack.begin(), stack.end(), tag);
+        if (it != stack.end()) {
+            position_hits[group][it - stack.begin()]++;
+            stack.erase(it);
+        } else if (stack.size() == associativity) {
+            stack.pop_back();
+        }
+        stack.insert(stack.begin(), tag);
+    }
+
+    // Lookahead-распределение: каждой группе минимум один путь, остаток отдается
+    // группе с наибольшей предельной полезностью на путь. Счетчики затем
+    // делятся пополам, чтобы старые эпохи постепенно забывались
+    std::vector<size_t> allocate() {
+        const size_t num_groups = position_hits.size();
+        std::vector<size_t> allocation(num_groups, 1);
+        size_t balance = associativity - num_groups;
+        while (balance > 0) {
+            double best_utility = -1;
+            size_t best_group = 0, best_ways = 1;
+            for (size_t group = 0; group < num_groups; ++group) {
+                uint64_t base = utility(group, allocation[group]);
+                for (size_t extra = 1; extra <= balance; ++extra) {
+                    double marginal = static_cast<double>(utility(group, allocation[group] + extra) - base) / extra;
+                    if (marginal > best_utility) {
+                        best_utility = marginal;
+                        best_group = group;
+                        best_ways = extra;
+                    }
+                }
+            }
+            allocation[best_group] += best_ways;
+            balance -= best_ways;
+        }
+
+        for (auto& hits : position_hits) {
+            for (auto& counter : hits) {
+                counter /= 2;
+            }
         }
-        LogEntry entry = parse_log_line(line);
-        cache_hierarchy.access(entry.address, entry.thread_id);
+        return allocation;
+    }
+};
+
+
+// Маски из непрерывных диапазонов путей: группе i достаются ways[i] путей подряд
+std::vector<uint64_t> contiguous_way_masks(const std::vector<size_t>& ways) {
+    std::vector<uint64_t> masks;
+    size_t first = 0;
+    for (size_t count : ways) {
+        uint64_t mask = (count >= 64 ? ~0ULL : ((1ULL << count) - 1)) << first;
+        masks.push_back(mask);
+        first += count;
     }
+    return masks;
+}
+
+
+// Снимок состояния разделения в конце эпохи
+struct PartitionSample {
+    uint64_t accesses;
+    std::vector<size_t> ways;
+    std::vector<size_t> occupancy;
+    std::vector<size_t> hits;    // за эпоху
+    std::vector<size_t> misses;  // за эпоху
+};
+
+
+class Cache {
+private:
+    size_t size;           // размер кэша в байтах
+    size_t line_size;      // размер кэш-линии в байтах
+    size_t associativity;  // ассоциативность
+    bool is_shared;        // общий или приватный
+    size_t num_sets;       // количество сетов
 
-    cache_hierarchy.print_statistics();
+    // Линии хранятся кусками по 2^chunk_shift сетов (около CHUNK_BYTES); кусок
+    // выделяется при первой записи в любой из его сетов, сеты невыделенного
+    // куска пусты. Так частные кеши тысяч потоков и огромные общие уровни
+    // занимают память хоста только под действительно затронутые сеты.
+    // Куски берутся из арены (общей для всех кешей прогона или своей)
+    static const size_t CHUNK_BYTES = 4096;
+    std::shared_ptr<Arena> own_arena;
+    Arena* arena;
+    std::vector<CacheLine*> chunks;  // nullptr - кусок не выделен
+    unsigned chunk_shift;
+    size_t allocated_lines;
+    uint64_t access_counter;
+
+    uint64_t offset_bits;
+    uint64_t index_bits;
+    uint64_t set_mask;
+    uint64_t prime_sets;   // модуль для IndexFunction::Prime
+
+    // Тепловая карта сетов
+    std::vector<uint64_t> set_accesses;
+    std::vector<uint64_t> set_misses;
+
+    CacheOptions options;
+    ReusePredictor predictor;
+    std::mt19937_64 random;
+    uint64_t bypassed_line;  // линия, которой отказано в размещении при последнем промахе
+    bool has_bypassed_line;
+    uint64_t pending_writeback;  // адрес грязной линии, вытесненной последним обращением
+    bool has_pending_writeback;
+
+    // Фильтр L0: последняя линия, к которой было обращение или которая была
+    // размещена, - сет и путь, где она лежит, ее номер, сет индекса и тег.
+    // Хранятся номера; кеш только перемещается, линии в арене при этом остаются
+    // на месте
+    bool has_last_line;
+    size_t last_line_set, last_line_way;
+    uint64_t last_line_address;
+    size_t last_set_index;
+    uint64_t last_tag;
+
+    // Разделение путей между группами
+    std::vector<uint64_t> way_masks;
+    UtilityMonitor umon;
+    uint64_t partition_accesses;
+    std::vector<size_t> group_hits, group_misses;
+    std::vector<size_t> epoch_hits, epoch_misses;
+    std::vector<size_t> occupancy;
+    std::vector<PartitionSample> partition_timeline;
+    
+    // Статистика
+    CacheStats stats;
+
+public:
+    Cache() : size(0), line_size(0), associativity(0), 
+            is_shared(false), num_sets(0), arena(nullptr), chunk_shift(0), allocated_lines(0), access_counter(0),
+            offset_bits(0), index_bits(0), set_mask(0), prime_sets(1),
+            bypassed_line(0), has_bypassed_line(false), pending_writeback(0), has_pending_writeback(false),
+            has_last_line(false), last_line_set(0), last_line_way(0), last_line_address(0), last_set_index(0),
+            last_tag(0), partition_accesses(0) {
+    }
+
+    Cache(size_t size_bytes, size_t line_size_bytes, size_t associativity, bool shared,
+          const CacheOptions& options = CacheOptions()) 
+        : size(size_bytes), line_size(line_size_bytes), associativity(associativity), 
+          is_shared(shared), arena(options.arena), chunk_shift(0), allocated_lines(0), access_counter(0),
+          options(options),
+          random(options.seed),
+          bypassed_line(0), has_bypassed_line(false), pending_writeback(0), has_pending_writeback(false),
+          has_last_line(false), last_line_set(0), last_line_way(0), last_line_address(0), last_set_index(0),
+          last_tag(0), partition_accesses(0) {
+        
+        num_sets = size / (line_size * associativity);
+        while (chunk_shift < 20 && (sizeof(CacheLine) * associativity << (chunk_shift + 1)) <= CHUNK_BYTES) {
+            chunk_shift++;
+        }
+        chunks.assign((num_sets + (size_t(1) << chunk_shift) - 1) >> chunk_shift, nullptr);
+        if (arena == nullptr) {
+            own_arena = std::make_shared<Arena>();
+            arena = own_arena.get();
+        }
+
+        offset_bits = log2(line_size);
+        index_bits = log2(num_sets);
+        set_mask = (1ULL << index_bits) - 1;
+        prime_sets = std::max<uint64_t>(num_sets, 1);
+        while (prime_sets > 2 && !is_prime(prime_sets)) {
+            --prime_sets;
+        }
+        if (options.set_heatmap) {
+            set_accesses.assign(num_sets, 0);
+            set_misses.assign(num_sets, 0);
+        }
+
+        if (options.admission == AdmissionPolicy::Sdbp || options.admission == AdmissionPolicy::Perceptron) {
+            predictor = ReusePredictor(options.admission, num_sets, associativity);
+        }
+
+        if (partitioned()) {
+            const size_t groups = options.partition_groups;
+            way_masks = options.way_masks;
+            if (way_masks.empty()) {
+                // Без явных масок пути делятся между группами поровну
+                std::vector<size_t> ways(groups, associativity / groups);
+                for (size_t i = 0; i < associativity % groups; ++i) {
+                    ways[i]++;
+                }
+                way_masks = contiguous_way_masks(ways);
+            }
+            way_masks.resize(groups, 0);  // группа без маски не размещает линий
+            if (options.partition == PartitionMode::Ucp) {
+                umon = UtilityMonitor(groups, num_sets, associativity);
+            }
+            group_hits.assign(groups, 0);
+            group_misses.assign(groups, 0);
+            epoch_hits.assign(groups, 0);
+            epoch_misses.assign(groups, 0);
+            occupancy.assign(groups, 0);
+        }
+    }
+
+    // Копия делила бы с оригиналом куски линий в арене
+    Cache(const Cache&) = delete;
+    Cache& operator=(const Cache&) = delete;
+    Cache(Cache&&) = default;
+    Cache& operator=(Cache&&) = default;
+
+    bool partitioned() const { return options.partition != PartitionMode::None; }
+
+
+    // count_cache = false - дозагрузка линии после промаха на нижнем уровне:
+    // не учитывается в статистике и не продвигает уже присутствующую линию в MRU,
+    // чтобы не отменять выбранную политикой позицию вставки
+    // group - группа потока при разделении путей, иначе не используется.
+    // is_write помечает линию грязной; запись с count_cache = false - это
+    // обратная запись с верхнего уровня, она размещается всегда, в обход политики допуска
+    bool access(uint64_t address, bool count_cache = true, uint64_t pc = 0, size_t group = 0,
+                bool is_write = false) {
+        return access_indexed(address, address, count_cache, pc, group, is_write);
+    }
+
+    // Обращение, в котором сет выбирается по index_address (виртуальному адресу
+    // при virtual_index), а тег - по address
+    bool access_indexed(uint64_t address, uint64_t index_address, bool count_cache = true, uint64_t pc = 0,
+                        size_t group = 0, bool is_write = false) {
+        const uint64_t line_address = address >> offset_bits;
+        const uint64_t index_line = index_address >> offset_bits;
+        // Повтор последней линии: она на прежнем месте, если слот по-прежнему
+        // занят тем же тегом, так что индекс и поиск по путям не нужны
+        CacheLine* const last_line = options.same_line_filter && has_last_line && line_address == last_line_address
+                                   ? &set_lines(last_line_set)[last_line_way] : nullptr;
+        const bool repeat = last_line != nullptr && last_line->valid && last_line->tag == last_tag;
+        const size_t set_index = repeat ? last_set_index : index_of(index_line);
+        const uint64_t tag = repeat ? last_tag : tag_of(line_address);
+
+        // В skewed-кеше путь way лежит в своем сете, в остальных случаях все пути в set_index
+        const bool skewed = options.index_function == IndexFunction::Skewed;
+        CacheLine* const set = skewed ? nullptr : set_lines(set_index);
+        auto way_line = [&](size_t way) -> CacheLine& {
+            return skewed ? set_lines(skewed_index(index_line, way))[way] : set[way];
+        };
+        auto remember = [&](size_t way) {
+            has_last_line = true;
+            last_line_set = skewed ? skewed_index(index_line, way) : set_index;
+            last_line_way = way;
+            last_line_address = line_address;
+            last_set_index = set_index;
+            last_tag = tag;
+        };
+
+        // Тепловая карта: обращение относится к сету, где линия нашлась или
+        // размещена (в skewed-кеше у каждого пути свой сет), промах без
+        // размещения - к set_index
+        auto count_set = [&](size_t set, bool miss) {
+            if (count_cache && !set_accesses.empty()) {
+                set_accesses[set]++;
+                set_misses[set] += miss;
+            }
+        };
+        if (predictor.enabled()) {
+            predictor.prepare(pc, tag);
+            if (count_cache) {
+                predictor.observe(set_index, tag, pc);
+            }
+        }
+        if (partitioned()) {
+            group %= options.partition_groups;
+            if (count_cache && options.partition == PartitionMode::Ucp) {
+                umon.observe(group, set_index, tag);
+            }
+        }
+
+        CacheLine* hit_line = repeat ? last_line : nullptr;
+        size_t hit_set = repeat ? last_line_set : set_index;
+        for (size_t way = 0; hit_line == nullptr && way < associativity; ++way) {
+            CacheLine& line = way_line(way);
+            if (line.valid && line.tag == tag) {
+                hit_line = &line;
+                hit_set = skewed ? skewed_index(index_line, way) : set_index;
+                if (options.same_line_filter) {
+                    remember(way);
+                }
+            }
+        }
+        if (hit_line != nullptr) {
+            hit_line->dirty |= is_write;
+            count_set(hit_set, false);
+            if (count_cache) {
+                hit_line->last_access_time = ++access_counter;
+                stats.hits++;
+                stats.filtered += repeat;
+                hit_line->last_hit_time = access_counter;
+                hit_line->hit_count++;
+                if (partitioned()) {
+                    record_group_access(group, true);
+                }
+            }
+            return true;  // cache hit
+        }
+
+        // Cache miss
+        if (count_cache) {
+            stats.misses++;
+            if (partitioned()) {
+                record_group_access(group, false);
+            }
+        }
+
+        if (!(is_write && !count_cache) && !admit(address / line_size, count_cache)) {
+            count_set(set_index, true);
+            if (count_cache) {
+                stats.bypasses++;
+            }
+            return false;
+        }
+        
+        // При разделении группа вытесняет только из своих путей
+        const uint64_t allowed = partitioned() ? way_masks[group] : ~0ULL;
+        CacheLine* replacement_line = nullptr;
+        size_t replacement_way = 0;
+        for (size_t way = 0; way < associativity; ++way) {
+            CacheLine& line = way_line(way);
+            if (!line.valid && (way >= 64 || (allowed >> way) & 1)) {
+                replacement_line = &line;
+                replacement_way = way;
+                break;
+            }
+        }
+
+        // LRU
+        if (!replacement_line) {
+            uint64_t oldest_time = UINT64_MAX;
+            for (size_t way = 0; way < associativity; ++way) {
+                CacheLine& line = way_line(way);
+                if (line.last_access_time < oldest_time && (way >= 64 || (allowed >> way) & 1)) {
+                    oldest_time = line.last_access_time;
+                    replacement_line = &line;
+                    replacement_way = way;
+                }
+            }
+            if (!replacement_line) {
+                // У группы нет ни одного пути - линия не размещается
+                count_set(set_index, true);
+                if (count_cache) {
+                    stats.bypasses++;
+                }
+                return false;
+            }
+            record_eviction(*replacement_line);
+            if (partitioned()) {
+                occupancy[replacement_line->owner]--;
+            }
+            if (replacement_line->dirty) {
+                stats.writebacks++;
+                has_pending_writeback = true;
+                pending_writeback = address_of_line(*replacement_line, set_index);
+            }
+        }
+
+        count_set(skewed ? skewed_index(index_line, replacement_way) : set_index, true);
+        if (partitioned()) {
+            occupancy[group]++;
+        }
+        replacement_line->owner = group;
+        replacement_line->valid = true;
+        replacement_line->tag = tag;
+        replacement_line->last_access_time = ++access_counter;
+        replacement_line->insert_time = access_counter;
+        replacement_line->last_hit_time = 0;
+        replacement_line->hit_count = 0;
+        replacement_line->dirty = is_write;
+        if (options.same_line_filter) {
+            remember(replacement_way);
+        }
+
+        if (options.admission == AdmissionPolicy::Bip && random_fraction() >= options.bip_epsilon) {
+            replacement_line->last_access_time = 0;  // LRU-позиция
+        }
+        
+        return false;  // cache miss
+    }
+
+    // Забирает адрес грязной линии, вытесненной последним обращением
+    bool take_writeback(uint64_t& address) {
+        if (!has_pending_writeback) {
+            return false;
+        }
+        has_pending_writeback = false;
+        address = pending_writeback;
+        return true;
+    }
+
+    // Снимает линию (clflush, некешируемая запись). Возвращает true, если линия была грязной.
+    // index_address, как в access_indexed(), выбирает сет
+    bool invalidate(uint64_t address) { return invalidate(address, address); }
+
+    bool invalidate(uint64_t address, uint64_t index_address) {
+        CacheLine* line = find_line(address, index_address);
+        if (line == nullptr) {
+            return false;
+        }
+        line->valid = false;
+        if (partitioned()) {
+            occupancy[line->owner]--;
+        }
+        const bool dirty = line->dirty;
+        line->dirty = false;
+        return dirty;
+    }
+
+    // Есть ли линия в кеше (без обновления LRU и статистики); dirty - грязная ли она
+    bool probe(uint64_t address, bool& dirty) { return probe(address, address, dirty); }
+
+    bool probe(uint64_t address, uint64_t index_address, bool& dirty) {
+        CacheLine* line = find_line(address, index_address);
+        dirty = line != nullptr && line->dirty;
+        return line != nullptr;
+    }
+
+    // Сет, куда попадет address (в skewed-кеше - сет нулевого пути)
+    size_t set_of(uint64_t address) const { return index_of(address >> offset_bits); }
+
+    // Программная предвыборка в кеш хоста сета set_index из set_of(). Предвыборка
+    // в два этапа: сначала описатель сета (header = true), позже, когда он уже
+    // в кеше хоста, - пути
+    void prefetch_set(size_t set_index, bool header) const {
+        if (chunks.empty()) {
+            return;
+        }
+        if (header) {
+            __builtin_prefetch(&chunks[set_index >> chunk_shift]);
+            return;
+        }
+        const CacheLine* set = existing_set(set_index);
+        if (set == nullptr) {
+            return;
+        }
+        const char* begin = reinterpret_cast<const char*>(set);
+        const char* end = reinterpret_cast<const char*>(set + associativity);
+        for (const char* host_line = begin; host_line < end; host_line += 64) {
+            __builtin_prefetch(host_line);
+        }
+    }
+
+    // Очищает линию, оставляя ее в кеше (clwb). Возвращает true, если линия была грязной
+    bool clean(uint64_t address) { return clean(address, address); }
+
+    bool clean(uint64_t address, uint64_t index_address) {
+        CacheLine* line = find_line(address, index_address);
+        if (line == nullptr || !line->dirty) {
+            return false;
+        }
+        line->dirty = false;
+        return true;
+    }
+
+    // Выделенные и все линии модели
+    size_t allocated_line_count() const { return allocated_lines; }
+    size_t line_count() const { return num_sets * associativity; }
+    uint64_t set_index_bits() const { return index_bits; }
+
+    // Память хоста под состояние кеша: выделенные линии, таблица кусков и тепловая карта
+    size_t host_memory_bytes() const {
+        return allocated_lines * sizeof(CacheLine) + chunks.size() * sizeof(chunks[0]) +
+               (set_accesses.size() + set_misses.size()) * sizeof(uint64_t);
+    }
+
+    // Адрес начала линии по тегу и номеру сета (при полных тегах тег - номер линии целиком)
+    uint64_t address_of_line(const CacheLine& line, uint64_t set_index) const {
+        return (full_tags() ? line.tag : (line.tag << index_bits) | set_index) << offset_bits;
+    }
+
+    // Занятые линии и линии, адрес которых удовлетворяет predicate
+    template <typename Predicate>
+    void count_lines(Predicate predicate, size_t& valid, size_t& matching) const {
+        for (size_t set = 0; set < num_sets; ++set) {
+            const CacheLine* lines = existing_set(set);
+            for (size_t way = 0; lines != nullptr && way < associativity; ++way) {
+                const CacheLine& line = lines[way];
+                if (!line.valid) {
+                    continue;
+                }
+                valid++;
+                if (predicate(address_of_line(line, set))) {
+                    matching++;
+                }
+            }
+        }
+    }
+
+    void get_statistics(size_t& out_hits, size_t& out_misses) const {
+        out_hits = stats.hits;
+        out_misses = stats.misses;
+    }
+
+    const CacheStats& statistics() const { return stats; }
+
+    void write_partition_json(JsonWriter& json) const {
+        json.begin_object("partition");
+        json.value("mode", std::string(options.partition == PartitionMode::Ucp ? "ucp" : "static"));
+        json.value("epoch", options.partition_epoch);
+        json.begin_array("groups");
+        for (size_t group = 0; group < group_hits.size(); ++group) {
+            size_t total = group_hits[group] + group_misses[group];
+            json.begin_object();
+            json.value("group", group);
+            json.value("hits", group_hits[group]);
+            json.value("misses", group_misses[group]);
+            json.value("hit_rate", total ? static_cast<double>(group_hits[group]) / total : 0.0);
+            json.value("occupancy", occupancy[group]);
+            json.value("ways", static_cast<size_t>(__builtin_popcountll(way_masks[group])));
+            json.value("way_mask", way_masks[group]);
+            json.end_object();
+        }
+        json.end_array();
+
+        json.begin_array("timeline");
+        for (const PartitionSample& sample : partition_timeline) {
+            json.begin_object();
+            json.value("accesses", sample.accesses);
+            json.begin_array("ways");
+            for (size_t ways : sample.ways) json.element(ways);
+            json.end_array();
+            json.begin_array("occupancy");
+            for (size_t lines : sample.occupancy) json.element(lines);
+            json.end_array();
+            json.begin_array("hits");
+            for (size_t hits : sample.hits) json.element(hits);
+            json.end_array();
+            json.begin_array("misses");
+            for (size_t misses : sample.misses) json.element(misses);
+            json.end_array();
+            json.end_object();
+        }
+        json.end_array();
+        json.end_object();
+    }
+
+    bool has_heatmap() const { return !set_accesses.empty(); }
+
+    // Сводка по неравномерности обращений к сетам и самые конфликтные сеты
+    void write_heatmap_json(JsonWriter& json) const {
+        const size_t reachable_sets = reachable_set_count();
+        uint64_t total = 0, max_accesses = 0, used_sets = 0;
+        for (uint64_t accesses : set_accesses) {
+            total += accesses;
+            max_accesses = std::max(max_accesses, accesses);
+            used_sets += accesses != 0;
+        }
+        const double mean = reachable_sets ? static_cast<double>(total) / reachable_sets : 0.0;
+        double variance = 0;
+        for (size_t set = 0; set < reachable_sets; ++set) {
+            variance += (set_accesses[set] - mean) * (set_accesses[set] - mean);
+        }
+        variance = reachable_sets ? variance / reachable_sets : 0.0;
+
+        std::vector<size_t> order(num_sets);
+        for (size_t set = 0; set < num_sets; ++set) {
+            order[set] = set;
+        }
+        const size_t top = std::min<size_t>(16, num_sets);
+        std::partial_sort(order.begin(), order.begin() + top, order.end(), [&](size_t a, size_t b) {
+            return set_misses[a] > set_misses[b];
+        });
+
+        json.begin_object("set_heatmap");
+        json.value("sets", num_sets);
+        json.value("reachable_sets", reachable_sets);
+        json.value("used_sets", used_sets);
+        json.value("max_set_accesses", max_accesses);
+        json.value("mean_set_accesses", mean);
+        json.value("access_cv", mean > 0 ? std::sqrt(variance) / mean : 0.0);
+        json.begin_array("top_miss_sets");
+        for (size_t i = 0; i < top && set_misses[order[i]] != 0; ++i) {
+            json.begin_object();
+            json.value("set", order[i]);
+            json.value("accesses", set_accesses[order[i]]);
+            json.value("misses", set_misses[order[i]]);
+            json.end_object();
+        }
+        json.end_array();
+        json.end_object();
+    }
+
+    // Полная карта: строки level,set,accesses,misses для сетов, к которым обращались
+    void write_heatmap_csv(std::ostream& out, const std::string& level) const {
+        for (size_t set = 0; set < set_accesses.size(); ++set) {
+            if (set_accesses[set] != 0 || set_misses[set] != 0) {
+                out << level << "," << set << "," << set_accesses[set] << "," << set_misses[set] << "\n";
+            }
+        }
+    }
+
+private:
+    static bool is_prime(uint64_t value) {
+        for (uint64_t divisor = 2; divisor * divisor <= value; ++divisor) {
+            if (value % divisor == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Сеты, в которые вообще может попасть линия при выбранной функции индекса
+    size_t reachable_set_count() const {
+        return options.index_function == IndexFunction::Prime ? prime_sets : std::min<size_t>(num_sets, set_mask + 1);
+    }
+
+    size_t skewed_index(uint64_t line_address, size_t way) const {
+        if (index_bits == 0) {
+            return 0;
+        }
+        uint64_t hash = (line_address ^ (line_address >> 23) ^ (way * 0x9e3779b97f4a7c15ULL)) * 0xff51afd7ed558ccdULL;
+        return hash >> (64 - index_bits);
+    }
+
+    // При хешированном индексе или индексе по виртуальному адресу номер линии
+    // не восстанавливается по сету, и в теге хранится весь номер линии
+    bool full_tags() const { return options.index_function != IndexFunction::Modulo || options.virtual_index; }
+
+    uint64_t tag_of(uint64_t line_address) const { return full_tags() ? line_address : line_address >> index_bits; }
+
+    CacheLine* find_line(uint64_t address, uint64_t index_address) {
+        const uint64_t index_line = index_address >> offset_bits;
+        const size_t set_index = index_of(index_line);
+        const uint64_t tag = tag_of(address >> offset_bits);
+        const bool skewed = options.index_function == IndexFunction::Skewed;
+        for (size_t way = 0; way < associativity; ++way) {
+            CacheLine* lines = existing_set(skewed ? skewed_index(index_line, way) : set_index);
+            if (lines != nullptr && lines[way].valid && lines[way].tag == tag) {
+                return &lines[way];
+            }
+        }
+        return nullptr;
+    }
+
+    // Линии сета для обращения; выделяет кусок при первом касании
+    CacheLine* set_lines(size_t set_index) {
+        CacheLine*& chunk = chunks[set_index >> chunk_shift];
+        if (chunk == nullptr) {
+            const size_t first_set = set_index >> chunk_shift << chunk_shift;
+            const size_t lines = std::min(size_t(1) << chunk_shift, num_sets - first_set) * associativity;
+            chunk = arena->allocate_array<CacheLine>(lines);
+            allocated_lines += lines;
+        }
+        return chunk + (set_index & ((size_t(1) << chunk_shift) - 1)) * associativity;
+    }
+
+    // Линии уже выделенного сета, nullptr - сет не затронут (все пути пусты)
+    const CacheLine* existing_set(size_t set_index) const {
+        const CacheLine* chunk = chunks[set_index >> chunk_shift];
+        return chunk == nullptr ? nullptr : chunk + (set_index & ((size_t(1) << chunk_shift) - 1)) * associativity;
+    }
+
+    CacheLine* existing_set(size_t set_index) {
+        return const_cast<CacheLine*>(static_cast<const Cache&>(*this).existing_set(set_index));
+    }
+
+    size_t index_of(uint64_t line_address) const {
+        switch (options.index_function) {
+            case IndexFunction::Xor: {
+                uint64_t folded = 0;
+                for (uint64_t rest = line_address; rest != 0 && index_bits != 0; rest >>= index_bits) {
+                    folded ^= rest;
+                }
+                return folded & set_mask;
+            }
+            case IndexFunction::Prime:
+                return line_address % prime_sets;
+            case IndexFunction::Skewed:
+                return skewed_index(line_address, 0);
+            default:
+                return line_address & set_mask;
+        }
+    }
+
+    void record_group_access(size_t group, bool hit) {
+        (hit ? group_hits : group_misses)[group]++;
+        (hit ? epoch_hits : epoch_misses)[group]++;
+        if (++partition_accesses % options.partition_epoch != 0) {
+            return;
+        }
+
+        if (options.partition == PartitionMode::Ucp) {
+            way_masks = contiguous_way_masks(umon.allocate());
+        }
+
+        PartitionSample sample;
+        sample.accesses = partition_accesses;
+        for (uint64_t mask : way_masks) {
+            sample.ways.push_back(__builtin_popcountll(mask));
+        }
+        sample.occupancy = occupancy;
+        sample.hits = epoch_hits;
+        sample.misses = epoch_misses;
+        partition_timeline.push_back(sample);
+        std::fill(epoch_hits.begin(), epoch_hits.end(), 0);
+        std::fill(epoch_misses.begin(), epoch_misses.end(), 0);
+    }
+
+    double random_fraction() {
+        return (random() >> 11) * (1.0 / (1ULL << 53));
+    }
+
+    // Решение о размещении принимается при учитываемом промахе; последующая
+    // дозагрузка той же линии повторяет его, а не разыгрывает заново
+    bool admit(uint64_t line_address, bool count_cache) {
+        if (!count_cache && has_bypassed_line && bypassed_line == line_address) {
+            return false;
+        }
+
+        bool bypass = false;
+        switch (options.admission) {
+            case AdmissionPolicy::Probabilistic:
+                bypass = random_fraction() >= options.admission_probability;
+                break;
+            case AdmissionPolicy::Sdbp:
+            case AdmissionPolicy::Perceptron:
+                bypass = predictor.predict_dead();
+                break;
+            default:
+                break;
+        }
+
+        if (count_cache) {
+            has_bypassed_line = bypass;
+            bypassed_line = line_address;
+        }
+        return !bypass;
+    }
+
+    void record_eviction(const CacheLine& line) {
+        uint64_t last_use = std::max(line.insert_time, line.last_hit_time);
+        stats.evictions++;
+        if (line.hit_count == 0) {
+            stats.dead_evictions++;
+        }
+        stats.eviction_age.add(access_counter - line.insert_time);
+        stats.dead_time.add(access_counter - last_use);
+        stats.hits_before_eviction.add(line.hit_count);
+    }
+};
+
+
+// Поля статистики уровня кеша в текущем объекте JSON
+void write_cache_fields(JsonWriter& json, const CacheStats& stats, const Cache* cache = nullptr) {
+    json.value("hits", stats.hits);
+    json.value("misses", stats.misses);
+    json.value("hit_rate", stats.hit_rate());
+    json.value("evictions", stats.evictions);
+    json.value("bypasses", stats.bypasses);
+    json.value("bypass_rate", stats.bypass_rate());
+    json.value("writebacks", stats.writebacks);
+    json.value("dead_evictions", stats.dead_evictions);
+    json.value("l0_filtered", stats.filtered);
+    json.value("dead_block_ratio", stats.dead_block_ratio());
+    json.value("dead_time_fraction", stats.dead_time_fraction());
+    json.histogram("eviction_age", stats.eviction_age);
+    json.histogram("dead_time", stats.dead_time);
+    json.histogram("hits_before_eviction", stats.hits_before_eviction);
+    if (cache && cache->partitioned()) {
+        cache->write_partition_json(json);
+    }
+    if (cache && cache->has_heatmap()) {
+        cache->write_heatmap_json(json);
+    }
+}
+
+
+// Выбор слайса LLC по адресу линии
+enum class SliceHash {
+    Modulo,  // биты адреса линии над индексом сета слайса по модулю числа слайсов
+    Xor,     // XOR-свертка адреса линии
+    Intel    // приближение complex addressing Intel: биты номера слайса - четности масок адреса (до 8 слайсов)
+};
+
+bool parse_slice_hash(const std::string& name, SliceHash& out) {
+    static const std::pair<const char*, SliceHash> names[] = {
+        {"modulo", SliceHash::Modulo},
+        {"xor", SliceHash::Xor},
+        {"intel", SliceHash::Intel},
+    };
+    for (const auto& it : names) {
+        if (name == it.first) {
+            out = it.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Топология межсоединения между ядрами и слайсами
+enum class Interconnect {
+    Ring,  // двунаправленное кольцо, число переходов - кратчайшее расстояние по кольцу
+    Mesh   // двумерная сетка, число переходов - манхэттенское расстояние
+};
+
+bool parse_interconnect(const std::string& name, Interconnect& out) {
+    if (name == "ring") {
+        out = Interconnect::Ring;
+    } else if (name == "mesh") {
+        out = Interconnect::Mesh;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+struct NucaOptions {
+    size_t slices = 1;
+    SliceHash hash = SliceHash::Modulo;
+    Interconnect topology = Interconnect::Ring;
+    size_t hop_latency = 1;   // тактов на переход
+    size_t mesh_columns = 0;  // ширина сетки, 0 - примерно квадратная
+};
+
+
+// NUCA LLC: общий кеш разбит на слайсы, каждый слайс - отдельный Cache со своей
+// долей емкости. Слайсы стоят в узлах кольца или сетки, ядра распределены по
+// тем же узлам равномерно; стоимость обращения растет с числом переходов
+// от узла ядра до узла слайса.
+class SlicedCache {
+private:
+    std::vector<Cache> slices;
+    NucaOptions options;
+    size_t num_cores;
+    size_t line_size;
+    size_t mesh_columns;
+    uint64_t slice_index_bits;  // биты индекса сета внутри слайса; Modulo берет номер слайса выше них
+
+    std::vector<size_t> slice_accesses;
+    uint64_t last_interconnect;  // задержка сети последнего обращения
+    size_t last_slice;
+    uint64_t total_hops;
+    uint64_t interconnect_cycles;
+    Histogram hops;
+
+    // Маски битов физического адреса для битов номера слайса
+    // (по результатам реверс-инжиниринга Maurice et al., 2015, для 2/4/8 слайсов)
+    static constexpr size_t INTEL_MAX_SLICES = 8;
+    static uint64_t intel_slice_bits(uint64_t address) {
+        static const uint64_t masks[] = {
+            0x1b5f575440ULL,
+            0x2eb5faa880ULL,
+            0x3cccc93100ULL,
+        };
+        uint64_t bits = 0;
+        for (size_t i = 0; i < 3; ++i) {
+            bits |= static_cast<uint64_t>(__builtin_parityll(address & masks[i])) << i;
+        }
+        return bits;
+    }
+
+    size_t stop_of_core(size_t core) const {
+        return (core % num_cores) * slices.size() / num_cores;
+    }
+
+    size_t hop_count(size_t from, size_t to) const {
+        if (options.topology == Interconnect::Mesh) {
+            size_t dx = from % mesh_columns > to % mesh_columns ? from % mesh_columns - to % mesh_columns
+                                                                : to % mesh_columns - from % mesh_columns;
+            size_t dy = from / mesh_columns > to / mesh_columns ? from / mesh_columns - to / mesh_columns
+                                                                : to / mesh_columns - from / mesh_columns;
+            return dx + dy;
+        }
+        size_t distance = from > to ? from - to : to - from;
+        return std::min(distance, slices.size() - distance);
+    }
+
+public:
+    SlicedCache(size_t num_cores, size_t size_bytes, size_t line_size_bytes, size_t associativity,
+                const CacheOptions& cache_options, const NucaOptions& nuca_options)
+        : options(nuca_options), num_cores(std::max<size_t>(num_cores, 1)), line_size(line_size_bytes),
+          slice_index_bits(0), last_interconnect(0), last_slice(0), total_hops(0), interconnect_cycles(0) {
+        const size_t count = std::max<size_t>(options.slices, 1);
+        for (size_t i = 0; i < count; ++i) {
+            CacheOptions slice_options = cache_options;
+            slice_options.seed += i;
+            slices.emplace_back(size_bytes / count, line_size_bytes, associativity, true, slice_options);
+        }
+        slice_index_bits = slices[0].set_index_bits();
+        slice_accesses.assign(count, 0);
+        mesh_columns = options.mesh_columns;
+        if (mesh_columns == 0) {
+            mesh_columns = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+        }
+    }
+
+    size_t slice_of(uint64_t address) const {
+        const size_t count = slices.size();
+        const uint64_t line_address = address / line_size;
+        switch (options.hash) {
+            case SliceHash::Xor: {
+                uint64_t folded = 0;
+                const size_t bits = std::max<size_t>(1, static_cast<size_t>(std::ceil(std::log2(count))));
+                for (uint64_t rest = line_address; rest != 0; rest >>= bits) {
+                    folded ^= rest;
+                }
+                return (folded & ((1ULL << bits) - 1)) % count;
+            }
+            case SliceHash::Intel:
+                // Для числа слайсов, не равного степени двойки, берется остаток - это лишь приближение
+                return intel_slice_bits(address) % count;
+            default:
+                // Биты индекса сета каждый слайс использует сам: если бы номер слайса
+                // брался из них же, в каждом слайсе была бы занята лишь 1/count сетов
+                return (line_address >> slice_index_bits) % count;
+        }
+    }
+
+    // core - номер ядра, с которого пришел запрос (для подсчета переходов)
+    bool access(uint64_t address, bool count_cache, uint64_t pc, size_t group, size_t core, bool is_write = false) {
+        const size_t slice = slice_of(address);
+        last_slice = slice;
+        const size_t distance = hop_count(stop_of_core(core), slice);
+        last_interconnect = distance * options.hop_latency;
+        if (count_cache) {
+            slice_accesses[slice]++;
+            total_hops += distance;
+            interconnect_cycles += distance * options.hop_latency;
+            hops.add(distance);
+        }
+        return slices[slice].access(address, count_cache, pc, group, is_write);
+    }
+
+    bool take_writeback(uint64_t& address) {
+        return slices[last_slice].take_writeback(address);
+    }
+
+    bool invalidate(uint64_t address) { return slices[slice_of(address)].invalidate(address); }
+    bool clean(uint64_t address) { return slices[slice_of(address)].clean(address); }
+    size_t set_of(uint64_t address, size_t slice) const { return slices[slice].set_of(address); }
+    void prefetch_set(size_t slice, size_t set_index, bool header) const { slices[slice].prefetch_set(set_index, header); }
+
+    size_t allocated_line_count() const {
+        size_t lines = 0;
+        for (const Cache& slice : slices) {
+            lines += slice.allocated_line_count();
+        }
+        return lines;
+    }
+
+    size_t line_count() const {
+        size_t lines = 0;
+        for (const Cache& slice : slices) {
+            lines += slice.line_count();
+        }
+        return lines;
+    }
+
+    size_t host_memory_bytes() const {
+        size_t bytes = 0;
+        for (const Cache& slice : slices) {
+            bytes += slice.host_memory_bytes();
+        }
+        return bytes;
+    }
+
+    template <typename Predicate>
+    void count_lines(Predicate predicate, size_t& valid, size_t& matching) const {
+        for (const Cache& slice : slices) {
+            slice.count_lines(predicate, valid, matching);
+        }
+    }
+
+    // Задержка сети от ядра до слайса при последнем обращении
+    uint64_t last_interconnect_latency() const { return last_interconnect; }
+
+    size_t slice_count() const { return slices.size(); }
+
+    // Наибольшее число слайсов, для которого определена функция хеширования
+    static size_t max_slices(SliceHash hash) { return hash == SliceHash::Intel ? INTEL_MAX_SLICES : SIZE_MAX; }
+
+    CacheStats statistics() const {
+        CacheStats total;
+        for (const Cache& slice : slices) {
+            total.merge(slice.statistics());
+        }
+        return total;
+    }
+
+    void get_statistics(size_t& out_hits, size_t& out_misses) const {
+        CacheStats total = statistics();
+        out_hits = total.hits;
+        out_misses = total.misses;
+    }
+
+    void write_heatmap_csv(std::ostream& out, const std::string& level) const {
+        for (size_t i = 0; i < slices.size(); ++i) {
+            slices[i].write_heatmap_csv(out, slices.size() == 1 ? level : level + "_slice" + std::to_string(i));
+        }
+    }
+
+    void write_json(JsonWriter& json, const std::string& name) const {
+        json.begin_object(name);
+        if (slices.size() == 1) {
+            write_cache_fields(json, slices[0].statistics(), &slices[0]);
+            json.end_object();
+            return;
+        }
+
+        write_cache_fields(json, statistics());
+        json.begin_object("nuca");
+        json.value("slices", slices.size());
+        json.value("total_hops", total_hops);
+        json.value("interconnect_cycles", interconnect_cycles);
+        json.histogram("hops", hops);
+        json.begin_array("per_slice");
+        for (size_t i = 0; i < slices.size(); ++i) {
+            json.begin_object();
+            json.value("slice", i);
+            json.value("accesses", slice_accesses[i]);
+            write_cache_fields(json, slices[i].statistics(), &slices[i]);
+            json.end_object();
+        }
+        json.end_array();
+        json.end_object();
+        json.end_object();
+    }
+};
+
+
+// Политика строкового буфера DRAM
+enum class PagePolicy {
+    Open,   // строка остается открытой до обращения к другой строке банка
+    Closed  // строка закрывается (precharge) после каждого обращения
+};
+
+// Раскладка адреса линии по каналам, рангам, банкам, строкам и столбцам (от старших к младшим)
+enum class DramMapping {
+    RowRankBankColumnChannel,  // соседние линии в одной строке: больше попаданий в строковый буфер
+    RowColumnRankBankChannel,  // соседние линии в разных банках: больше параллелизма банков
+    XorBank                    // как первая, но номер банка XOR-ится с младшими битами строки
+};
+
+bool parse_page_policy(const std::string& name, PagePolicy& out) {
+    if (name == "open") {
+        out = PagePolicy::Open;
+    } else if (name == "closed") {
+        out = PagePolicy::Closed;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parse_dram_mapping(const std::string& name, DramMapping& out) {
+    static const std::pair<const char*, DramMapping> names[] = {
+        {"row_rank_bank_col_chan", DramMapping::RowRankBankColumnChannel},
+        {"row_col_rank_bank_chan", DramMapping::RowColumnRankBankChannel},
+        {"xor_bank", DramMapping::XorBank},
+    };
+    for (const auto& it : names) {
+        if (name == it.first) {
+            out = it.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Все времена - в тактах процессора
+struct DramOptions {
+    size_t channels = 1;
+    size_t ranks = 1;
+    size_t banks = 8;             // банков в ранге
+    size_t row_size = 8192;       // байт в строке
+    size_t line_size = 64;
+    PagePolicy page_policy = PagePolicy::Open;
+    DramMapping mapping = DramMapping::RowRankBankColumnChannel;
+    uint64_t t_rcd = 42;          // активация строки
+    uint64_t t_cas = 42;          // чтение столбца
+    uint64_t t_rp = 42;           // закрытие строки
+    uint64_t t_burst = 8;         // передача линии по шине канала
+    uint64_t base_latency = 60;   // контроллер памяти и путь до него
+};
+
+
+// Модель DRAM: банки со строковыми буферами и общая шина данных каждого канала.
+// Запрос ждет освобождения банка (конфликт банка) и шины, задержка складывается
+// из ожидания, таймингов строки и передачи
+class DramModel {
+private:
+    struct Bank {
+        bool open;
+        uint64_t row;
+        uint64_t ready;  // когда банк может принять следующую команду
+
+        Bank() : open(false), row(0), ready(0) {}
+    };
+
+    DramOptions options;
+    std::vector<Bank> banks;
+    std::vector<uint64_t> bus_free;
+
+    size_t reads, writes;
+    size_t row_hits, row_empty, row_conflicts;
+    size_t bank_conflicts;    // запрос пришел, когда банк еще занят
+    uint64_t bus_busy_cycles;
+    uint64_t first_arrival, last_completion;
+    Histogram queue_delay;
+    Histogram read_latency;
+
+public:
+    explicit DramModel(const DramOptions& dram_options = DramOptions())
+        : options(dram_options), reads(0), writes(0), row_hits(0), row_empty(0), row_conflicts(0),
+          bank_conflicts(0), bus_busy_cycles(0), first_arrival(UINT64_MAX), last_completion(0) {
+        options.channels = std::max<size_t>(options.channels, 1);
+        options.ranks = std::max<size_t>(options.ranks, 1);
+        options.banks = std::max<size_t>(options.banks, 1);
+        banks.resize(options.channels * options.ranks * options.banks);
+        bus_free.assign(options.channels, 0);
+    }
+
+    // Возвращает задержку запроса, пришедшего в момент arrival
+    uint64_t access(uint64_t address, uint64_t arrival, bool is_write) {
+        const uint64_t columns = std::max<size_t>(options.row_size / options.line_size, 1);
+        uint64_t rest = address / options.line_size;
+        uint64_t channel, rank, bank, row;
+        channel = rest % options.channels;
+        rest /= options.channels;
+        if (options.mapping == DramMapping::RowColumnRankBankChannel) {
+            bank = rest % options.banks;
+            rest /= options.banks;
+            rank = rest % options.ranks;
+            rest /= options.ranks;
+            rest /= columns;
+        } else {
+            rest /= columns;
+            bank = rest % options.banks;
+            rest /= options.banks;
+            rank = rest % options.ranks;
+            rest /= options.ranks;
+        }
+        row = rest;
+        if (options.mapping == DramMapping::XorBank) {
+            bank = (bank ^ row) % options.banks;
+        }
+
+        Bank& state = banks[(channel * options.ranks + rank) * options.banks + bank];
+        const uint64_t start = std::max(arrival, state.ready);
+        if (state.ready > arrival) {
+            bank_conflicts++;
+        }
+
+        uint64_t data_ready;
+        if (state.open && state.row == row) {
+            row_hits++;
+            data_ready = start + options.t_cas;
+        } else if (!state.open) {
+            row_empty++;
+            data_ready = start + options.t_rcd + options.t_cas;
+        } else {
+            row_conflicts++;
+            data_ready = start + options.t_rp + options.t_rcd + options.t_cas;
+        }
+
+        const uint64_t transfer = std::max(data_ready, bus_free[channel]);
+        const uint64_t completion = transfer + options.t_burst;
+        bus_free[channel] = completion;
+        bus_busy_cycles += options.t_burst;
+
+        if (options.page_policy == PagePolicy::Open) {
+            state.open = true;
+            state.row = row;
+            state.ready = data_ready;
+        } else {
+            state.open = false;
+            state.ready = completion + options.t_rp;
+        }
+
+        (is_write ? writes : reads)++;
+        first_arrival = std::min(first_arrival, arrival);
+        last_completion = std::max(last_completion, completion);
+        queue_delay.add(start - arrival + (transfer - data_ready));
+        const uint64_t latency = options.base_latency + completion - arrival;
+        if (!is_write) {
+            read_latency.add(latency);
+        }
+        return latency;
+    }
+
+    double row_hit_rate() const {
+        const size_t total = row_hits + row_empty + row_conflicts;
+        return total ? static_cast<double>(row_hits) / total : 0.0;
+    }
+
+    // Доля времени, когда шины каналов передавали данные
+    double bandwidth_utilization() const {
+        if (last_completion <= first_arrival || first_arrival == UINT64_MAX) {
+            return 0.0;
+        }
+        return static_cast<double>(bus_busy_cycles) / ((last_completion - first_arrival) * options.channels);
+    }
+
+    void write_json(JsonWriter& json) const {
+        json.begin_object("dram");
+        json.value("reads", reads);
+        json.value("writes", writes);
+        json.value("row_hits", row_hits);
+        json.value("row_empty", row_empty);
+        json.value("row_conflicts", row_conflicts);
+        json.value("row_hit_rate", row_hit_rate());
+        json.value("bank_conflicts", bank_conflicts);
+        json.value("bus_busy_cycles", bus_busy_cycles);
+        json.value("bandwidth_utilization", bandwidth_utilization());
+        json.value("bytes_transferred", static_cast<uint64_t>((reads + writes) * options.line_size));
+        json.histogram("queue_delay", queue_delay);
+        json.histogram("read_latency", read_latency);
+        json.end_object();
+    }
+};
+
+
+// Размещение страниц по уровням памяти
+enum class PagePlacement {
+    FirstTouch,  // в узел ядра, первым обратившегося к странице
+    Interleave   // по кругу по всем уровням
+};
+
+bool parse_page_placement(const std::string& name, PagePlacement& out) {
+    if (name == "first_touch") {
+        out = PagePlacement::FirstTouch;
+    } else if (name == "interleave") {
+        out = PagePlacement::Interleave;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+// Уровни памяти: numa_nodes узлов DRAM и, если cxl_capacity > 0, дальняя память CXL.
+// Емкость в байтах (0 - без ограничения), пропускная способность в байтах за такт
+// (0 - без ограничения), задержки добавляются к задержке памяти
+struct TierOptions {
+    size_t numa_nodes = 1;
+    size_t node_capacity = 0;
+    double node_bandwidth = 32.0;
+    uint64_t remote_latency = 60;   // доступ к узлу другого ядра
+    size_t cxl_capacity = 0;
+    double cxl_bandwidth = 8.0;
+    uint64_t cxl_latency = 170;
+    size_t page_size = 4096;
+    size_t line_size = 64;
+    PagePlacement placement = PagePlacement::FirstTouch;
+    bool migration = false;         // перенос горячих страниц в узел ядра
+    size_t migration_threshold = 32;  // обращений за эпоху, чтобы страница считалась горячей
+    size_t migration_epoch = 10000;   // обращений к памяти между решениями о переносе
+    uint64_t migration_cost = 2000;   // фиксированная цена переноса страницы в тактах
+};
+
+
+// Модель многоуровневой памяти. Каждая страница живет на одном уровне; узел ядра
+// определяется как core % numa_nodes. Обращение к чужому узлу или к CXL платит
+// дополнительную задержку и очередь к каналу уровня. Раз в эпоху горячие страницы,
+// к которым threshold раз подряд обращались с одного узла, переносятся в этот узел
+// (общие для узлов страницы не переносятся, чтобы не гонять их туда-обратно);
+// при нехватке места страница меняется местами с самой холодной страницей узла
+class TieredMemory {
+private:
+    struct Page {
+        uint16_t tier;
+        uint16_t last_node;        // узел последнего обратившегося ядра
+        uint32_t epoch_accesses;
+        uint32_t node_streak;      // обращений подряд с узла last_node
+    };
+
+    struct Tier {
+        size_t capacity_pages;  // 0 - без ограничения
+        size_t resident_pages;
+        double bandwidth;
+        uint64_t busy_until;
+        size_t reads, writes;
+        size_t local_accesses, remote_accesses;
+        size_t migrated_in, migrated_out;
+        Histogram queue_delay;
+
+        Tier() : capacity_pages(0), resident_pages(0), bandwidth(0.0), busy_until(0), reads(0), writes(0),
+                 local_accesses(0), remote_accesses(0), migrated_in(0), migrated_out(0) {}
+
+        bool has_room() const { return capacity_pages == 0 || resident_pages < capacity_pages; }
+    };
+
+    TierOptions options;
+    std::vector<Tier> tiers;
+    std::unordered_map<uint64_t, Page> pages;
+    size_t epoch_accesses;
+    size_t migrations;
+    uint64_t migration_cycles;
+
+    bool is_cxl(size_t tier) const { return tier >= options.numa_nodes; }
+
+    size_t home_node(size_t core) const { return core % options.numa_nodes; }
+
+    size_t place(uint64_t page_number, size_t core) {
+        if (options.placement == PagePlacement::Interleave) {
+            return page_number % tiers.size();
+        }
+        const size_t home = home_node(core);
+        if (tiers[home].has_room()) {
+            return home;
+        }
+        for (size_t i = 0; i < tiers.size(); ++i) {
+            if (tiers[i].has_room()) {
+                return i;
+            }
+        }
+        // Все уровни заполнены: страница уходит на последний (самый дальний)
+        return tiers.size() - 1;
+    }
+
+    // Время передачи size байт по каналу уровня, начиная не раньше arrival
+    uint64_t transfer(Tier& tier, uint64_t arrival, size_t size) {
+        if (tier.bandwidth <= 0.0) {
+            return arrival;
+        }
+        const uint64_t start = std::max(arrival, tier.busy_until);
+        tier.busy_until = start + static_cast<uint64_t>(std::ceil(size / tier.bandwidth));
+        return start;
+    }
+
+    void move_page(Page& page, size_t target, uint64_t now) {
+        Tier& from = tiers[page.tier];
+        Tier& to = tiers[target];
+        // Страница читается из одного уровня и пишется в другой
+        transfer(from, now, options.page_size);
+        transfer(to, now, options.page_size);
+        from.resident_pages--;
+        from.migrated_out++;
+        to.resident_pages++;
+        to.migrated_in++;
+        page.tier = static_cast<uint16_t>(target);
+        migrations++;
+        migration_cycles += options.migration_cost +
+            (to.bandwidth > 0.0 ? static_cast<uint64_t>(std::ceil(options.page_size / to.bandwidth)) : 0);
+    }
+
+    void migrate(uint64_t now) {
+        std::vector<std::pair<uint32_t, uint64_t> > hot;
+        std::vector<std::vector<std::pair<uint32_t, uint64_t> > > cold(tiers.size());
+        for (const auto& it : pages) {
+            const Page& page = it.second;
+            if (page.node_streak >= options.migration_threshold && page.tier != page.last_node) {
+                hot.push_back(std::make_pair(page.epoch_accesses, it.first));
+            } else if (!is_cxl(page.tier)) {
+                cold[page.tier].push_back(std::make_pair(page.epoch_accesses, it.first));
+            }
+        }
+        std::sort(hot.rbegin(), hot.rend());
+        for (auto& list : cold) {
+            std::sort(list.begin(), list.end());
+        }
+
+        std::vector<size_t> next_cold(tiers.size(), 0);
+        for (const auto& candidate : hot) {
+            Page& page = pages[candidate.second];
+            const size_t target = page.last_node;
+            if (!tiers[target].has_room()) {
+                // Самая холодная страница узла уходит на место горячей
+                size_t& next = next_cold[target];
+                if (next >= cold[target].size() || cold[target][next].first >= candidate.first) {
+                    continue;
+                }
+                move_page(pages[cold[target][next++].second], page.tier, now);
+            }
+            move_page(page, target, now);
+        }
+
+        for (auto& it : pages) {
+            it.second.epoch_accesses = 0;
+            it.second.node_streak = 0;
+        }
+    }
+
+public:
+    explicit TieredMemory(const TierOptions& tier_options = TierOptions())
+        : options(tier_options), epoch_accesses(0), migrations(0), migration_cycles(0) {
+        options.numa_nodes = std::max<size_t>(options.numa_nodes, 1);
+        options.page_size = std::max<size_t>(options.page_size, 1);
+        tiers.resize(options.numa_nodes + (options.cxl_capacity > 0 ? 1 : 0));
+        for (size_t i = 0; i < tiers.size(); ++i) {
+            const size_t capacity = is_cxl(i) ? options.cxl_capacity : options.node_capacity;
+            tiers[i].capacity_pages = capacity / options.page_size;
+            tiers[i].bandwidth = is_cxl(i) ? options.cxl_bandwidth : options.node_bandwidth;
+        }
+    }
+
+    // Дополнительная задержка обращения ядра core к линии address в момент arrival
+    uint64_t access(uint64_t address, size_t core, uint64_t arrival, bool is_write) {
+        const uint64_t page_number = address / options.page_size;
+        auto it = pages.find(page_number);
+        if (it == pages.end()) {
+            const size_t tier = place(page_number, core);
+            tiers[tier].resident_pages++;
+            it = pages.emplace(page_number, Page{static_cast<uint16_t>(tier), 0, 0, 0}).first;
+        }
+        Page& page = it->second;
+        const size_t node = home_node(core);
+        if (page.last_node != node) {
+            page.last_node = static_cast<uint16_t>(node);
+            page.node_streak = 0;
+        }
+        if (page.epoch_accesses < UINT32_MAX) {
+            page.epoch_accesses++;
+            page.node_streak++;
+        }
+
+        Tier& tier = tiers[page.tier];
+        (is_write ? tier.writes : tier.reads)++;
+        uint64_t extra = 0;
+        if (page.tier == node) {
+            tier.local_accesses++;
+        } else {
+            tier.remote_accesses++;
+            extra = is_cxl(page.tier) ? options.cxl_latency : options.remote_latency;
+        }
+        const uint64_t start = transfer(tier, arrival, options.line_size);
+        tier.queue_delay.add(start - arrival);
+        extra += start - arrival;
+
+        if (options.migration && ++epoch_accesses >= options.migration_epoch) {
+            epoch_accesses = 0;
+            migrate(arrival);
+        }
+        return extra;
+    }
+
+    // Доля обращений не к узлу своего ядра (включая CXL)
+    double remote_fraction() const {
+        size_t local = 0, remote = 0;
+        for (const Tier& tier : tiers) {
+            local += tier.local_accesses;
+            remote += tier.remote_accesses;
+        }
+        return local + remote ? static_cast<double>(remote) / (local + remote) : 0.0;
+    }
+
+    void write_json(JsonWriter& json) const {
+        json.begin_object("tiers");
+        json.value("page_size", options.page_size);
+        json.value("pages", pages.size());
+        json.value("remote_fraction", remote_fraction());
+        json.value("migrations", migrations);
+        json.value("migration_cycles", migration_cycles);
+        json.value("migration_bytes", static_cast<uint64_t>(migrations * options.page_size));
+        json.begin_array("per_tier");
+        for (size_t i = 0; i < tiers.size(); ++i) {
+            const Tier& tier = tiers[i];
+            json.begin_object();
+            json.value("name", is_cxl(i) ? std::string("cxl") : "node" + std::to_string(i));
+            json.value("resident_pages", tier.resident_pages);
+            json.value("reads", tier.reads);
+            json.value("writes", tier.writes);
+            json.value("bytes", static_cast<uint64_t>((tier.reads + tier.writes) * options.line_size));
+            json.value("local_accesses", tier.local_accesses);
+            json.value("remote_accesses", tier.remote_accesses);
+            json.value("migrated_in", tier.migrated_in);
+            json.value("migrated_out", tier.migrated_out);
+            json.histogram("queue_delay", tier.queue_delay);
+            json.end_object();
+        }
+        json.end_array();
+        json.end_object();
+    }
+};
+
+
+// Организация кеша на стороне памяти
+enum class MemoryCacheDesign {
+    Alloy,  // прямое отображение, тег хранится рядом с данными и читается одним обращением
+    Page    // множественно-ассоциативный со страничными блоками, теги сета читаются отдельно
+};
+
+bool parse_memory_cache_design(const std::string& name, MemoryCacheDesign& out) {
+    if (name == "alloy") {
+        out = MemoryCacheDesign::Alloy;
+    } else if (name == "page") {
+        out = MemoryCacheDesign::Page;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+struct MemoryCacheOptions {
+    MemoryCacheDesign design = MemoryCacheDesign::Alloy;
+    size_t size = 256 * 1024 * 1024;
+    size_t block_size = 0;        // 0 - 64 байта для alloy, 4096 для page
+    size_t associativity = 0;     // 0 - 1 для alloy, 8 для page
+    size_t line_size = 64;        // размер запроса от LLC
+    uint64_t hit_latency = 80;
+    uint64_t probe_latency = 40;  // проверка тега перед обращением в память при промахе
+};
+
+
+// Кеш на стороне памяти (DRAM cache, HBM) между LLC и памятью. Емкость - сотни
+// мегабайт и больше, поэтому сеты хранятся разреженно и создаются при первом
+// обращении. Теги лежат в самой DRAM кеша, и на каждое обращение тратится
+// пропускная способность; bandwidth bloat - отношение всех переданных байт
+// к полезным (данным, отданным при попадании)
+class MemorySideCache {
+private:
+    struct Block {
+        uint64_t tag;
+        uint64_t last_use;
+        bool dirty;
+    };
+
+    static const size_t TAG_BYTES = 8;
+
+    MemoryCacheOptions options;
+    size_t num_sets;
+    std::unordered_map<uint64_t, std::vector<Block> > sets;
+    uint64_t time;
+
+    size_t read_hits, read_misses;
+    size_t write_hits, write_misses;
+    size_t fills, dirty_evictions;
+    uint64_t tag_bytes, data_bytes, fill_bytes, writeback_bytes;
+    bool has_writeback;
+    uint64_t pending_writeback;
+
+    // Байт, читаемых при проверке тегов одного сета
+    uint64_t probe_bytes() const {
+        return options.design == MemoryCacheDesign::Alloy ? options.line_size + TAG_BYTES
+                                                          : options.associativity * TAG_BYTES;
+    }
+
+public:
+    explicit MemorySideCache(const MemoryCacheOptions& cache_options = MemoryCacheOptions())
+        : options(cache_options), time(0), read_hits(0), read_misses(0), write_hits(0), write_misses(0),
+          fills(0), dirty_evictions(0), tag_bytes(0), data_bytes(0), fill_bytes(0), writeback_bytes(0),
+          has_writeback(false), pending_writeback(0) {
+        const bool alloy = options.design == MemoryCacheDesign::Alloy;
+        if (options.block_size == 0) {
+            options.block_size = alloy ? options.line_size : 4096;
+        }
+        if (options.associativity == 0) {
+            options.associativity = alloy ? 1 : 8;
+        }
+        num_sets = std::max<size_t>(options.size / (options.block_size * options.associativity), 1);
+    }
+
+    // Запись (обратная запись из LLC) без попадания не размещается и идет в память
+    bool access(uint64_t address, bool is_write) {
+        const uint64_t block = address / options.block_size;
+        const uint64_t set_index = block % num_sets;
+        const uint64_t tag = block / num_sets;
+        std::vector<Block>& set = sets[set_index];
+        time++;
+        tag_bytes += probe_bytes();
+
+        for (Block& entry : set) {
+            if (entry.tag == tag) {
+                entry.last_use = time;
+                if (is_write) {
+                    entry.dirty = true;
+                    write_hits++;
+                } else {
+                    read_hits++;
+                }
+                // У alloy данные пришли вместе с тегом
+                if (options.design != MemoryCacheDesign::Alloy) {
+                    data_bytes += options.line_size;
+                }
+                return true;
+            }
+        }
+
+        if (is_write) {
+            write_misses++;
+            return false;
+        }
+
+        read_misses++;
+        fills++;
+        fill_bytes += options.block_size + (options.design == MemoryCacheDesign::Alloy ? TAG_BYTES : 0);
+        if (set.size() < options.associativity) {
+            set.push_back(Block{tag, time, false});
+            return false;
+        }
+
+        Block* victim = &set[0];
+        for (Block& entry : set) {
+            if (entry.last_use < victim->last_use) {
+                victim = &entry;
+            }
+        }
+        if (victim->dirty) {
+            dirty_evictions++;
+            writeback_bytes += options.block_size;
+            has_writeback = true;
+            pending_writeback = (victim->tag * num_sets + set_index) * options.block_size;
+        }
+        *victim = Block{tag, time, false};
+        return false;
+    }
+
+    // Вытесненный грязный блок (адрес его начала), который надо записать в память
+    bool take_writeback(uint64_t& address) {
+        if (!has_writeback) {
+            return false;
+        }
+        has_writeback = false;
+        address = pending_writeback;
+        return true;
+    }
+
+    size_t block_size() const { return options.block_size; }
+    size_t line_size() const { return options.line_size; }
+    uint64_t hit_latency() const { return options.hit_latency; }
+    uint64_t probe_latency() const { return options.probe_latency; }
+
+    double hit_rate() const {
+        const size_t total = read_hits + read_misses;
+        return total ? static_cast<double>(read_hits) / total : 0.0;
+    }
+
+    double bandwidth_bloat() const {
+        const uint64_t useful = (read_hits + write_hits) * options.line_size;
+        return useful ? static_cast<double>(tag_bytes + data_bytes + fill_bytes + writeback_bytes) / useful : 0.0;
+    }
+
+    void write_json(JsonWriter& json) const {
+        json.begin_object("memory_side_cache");
+        json.value("design", std::string(options.design == MemoryCacheDesign::Alloy ? "alloy" : "page"));
+        json.value("size", options.size);
+        json.value("block_size", options.block_size);
+        json.value("associativity", options.associativity);
+        json.value("allocated_sets", sets.size());
+        json.value("total_sets", num_sets);
+        json.value("read_hits", read_hits);
+        json.value("read_misses", read_misses);
+        json.value("write_hits", write_hits);
+        json.value("write_misses", write_misses);
+        json.value("hit_rate", hit_rate());
+        json.value("fills", fills);
+        json.value("dirty_evictions", dirty_evictions);
+        json.value("tag_bytes", tag_bytes);
+        json.value("data_bytes", data_bytes);
+        json.value("fill_bytes", fill_bytes);
+        json.value("writeback_bytes", writeback_bytes);
+        json.value("bandwidth_bloat", bandwidth_bloat());
+        json.end_object();
+    }
+};
+
+
+// Регистры промахов (MSHR) одного уровня: линии, загрузка которых еще не
+// завершилась, и время готовности. Повторный промах в линию, которая уже
+// загружается, не порождает нового запроса, а ждет ее готовности (merge).
+// Время у разных потоков свое, поэтому для общих уровней модель приближенная
+class MshrFile {
+private:
+    size_t entries;
+    std::vector<std::pair<uint64_t, uint64_t> > in_flight;  // линия, время готовности
+
+    void retire(uint64_t now) {
+        for (size_t i = 0; i < in_flight.size();) {
+            if (in_flight[i].second <= now) {
+                in_flight[i] = in_flight.back();
+                in_flight.pop_back();
+            } else {
+                ++i;
+            }
+        }
+    }
+
+public:
+    size_t allocations;
+    size_t merges;
+    size_t full_waits;        // сколько раз пришлось ждать свободного регистра
+    uint64_t full_wait_cycles;
+
+    explicit MshrFile(size_t entries = 16) : entries(std::max<size_t>(entries, 1)), allocations(0), merges(0),
+                                              full_waits(0), full_wait_cycles(0) {}
+
+    // Если линия уже загружается и не готова к моменту now, возвращает время готовности
+    bool find(uint64_t line, uint64_t now, uint64_t& ready) {
+        for (const auto& entry : in_flight) {
+            if (entry.first == line && entry.second > now) {
+                ready = entry.second;
+                merges++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Момент, не раньше now, когда есть свободный регистр
+    uint64_t reserve(uint64_t now) {
+        retire(now);
+        if (in_flight.size() < entries) {
+            return now;
+        }
+        uint64_t earliest = UINT64_MAX;
+        for (const auto& entry : in_flight) {
+            earliest = std::min(earliest, entry.second);
+        }
+        full_waits++;
+        full_wait_cycles += earliest - now;
+        retire(earliest);
+        return earliest;
+    }
+
+    void insert(uint64_t line, uint64_t ready) {
+        in_flight.emplace_back(line, ready);
+        allocations++;
+    }
+
+    void merge_statistics(const MshrFile& other) {
+        allocations += other.allocations;
+        merges += other.merges;
+        full_waits += other.full_waits;
+        full_wait_cycles += other.full_wait_cycles;
+    }
+
+    void write_json(JsonWriter& json, const std::string& name) const {
+        json.begin_object(name);
+        json.value("entries", entries);
+        json.value("allocations", allocations);
+        json.value("merges", merges);
+        json.value("full_waits", full_waits);
+        json.value("full_wait_cycles", full_wait_cycles);
+        json.end_object();
+    }
+};
+
+
+// Параметры модели параллелизма памяти: поток выдает обращение каждые
+// issue_cycles тактов и может держать не более issue_window незавершенных
+// промахов (промахи считаются независимыми друг от друга)
+struct MlpOptions {
+    bool enabled = false;
+    size_t issue_window = 16;
+    size_t issue_cycles = 1;
+    size_t l1_mshrs = 16;
+    size_t l2_mshrs = 32;
+    size_t l3_mshrs = 64;
+};
+
+
+// Замещение в TLB
+enum class TlbReplacement {
+    Lru,
+    Random
+};
+
+bool parse_tlb_replacement(const std::string& name, TlbReplacement& out) {
+    if (name == "lru") {
+        out = TlbReplacement::Lru;
+    } else if (name == "random") {
+        out = TlbReplacement::Random;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Размер страницы "4k", "2m" или "1g" в логарифм размера
+bool parse_page_shift(const std::string& name, unsigned& out) {
+    if (name == "4k" || name == "4K") {
+        out = 12;
+    } else if (name == "2m" || name == "2M") {
+        out = 21;
+    } else if (name == "1g" || name == "1G") {
+        out = 30;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+// Размеры страниц по диапазонам виртуальных адресов. Адреса вне диапазонов
+// используют размер по умолчанию
+class PageSizeMap {
+private:
+    struct Range {
+        uint64_t start, end;  // [start, end)
+        unsigned shift;
+    };
+
+    unsigned default_shift;
+    std::vector<Range> ranges;  // отсортированы по началу, не пересекаются
+
+public:
+    explicit PageSizeMap(unsigned default_shift = 12) : default_shift(default_shift) {}
+
+    void add(uint64_t start, uint64_t end, unsigned shift) {
+        ranges.push_back(Range{start, end, shift});
+        std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.start < b.start; });
+    }
+
+    unsigned page_shift(uint64_t address) const {
+        auto it = std::upper_bound(ranges.begin(), ranges.end(), address,
+                                   [](uint64_t value, const Range& range) { return value < range.start; });
+        if (it != ranges.begin() && address < (it - 1)->end) {
+            return (it - 1)->shift;
+        }
+        return default_shift;
+    }
+
+    size_t range_count() const { return ranges.size(); }
+};
+
+
+// Множественно-ассоциативный TLB. Записи разных размеров страниц лежат в одном
+// массиве, сет выбирается по номеру виртуальной страницы ее размера
+// (размер страницы известен заранее, как при раздельных массивах по размерам)
+class Tlb {
+private:
+    struct Entry {
+        uint64_t vpn;
+        uint64_t last_use;
+        unsigned shift;
+        bool valid;
+    };
+
+    size_t num_sets;
+    size_t ways;
+    TlbReplacement replacement;
+    std::vector<Entry> entries;
+    std::mt19937_64 rng;
+    uint64_t time;
+    size_t hits, misses;
+
+public:
+    Tlb(size_t num_entries = 64, size_t associativity = 4, TlbReplacement replacement = TlbReplacement::Lru,
+        uint64_t seed = 1)
+        : ways(std::max<size_t>(std::min(associativity, num_entries), 1)), replacement(replacement),
+          rng(seed), time(0), hits(0), misses(0) {
+        num_sets = std::max<size_t>(num_entries / ways, 1);
+        entries.assign(num_sets * ways, Entry{0, 0, 0, false});
+    }
+
+    // Поиск перевода; при промахе перевод помещается в TLB
+    bool access(uint64_t address, unsigned shift) {
+        const uint64_t vpn = address >> shift;
+        Entry* set = &entries[(vpn % num_sets) * ways];
+        time++;
+        Entry* victim = nullptr;
+        for (size_t i = 0; i < ways; ++i) {
+            if (set[i].valid && set[i].vpn == vpn && set[i].shift == shift) {
+                set[i].last_use = time;
+                hits++;
+                return true;
+            }
+            if (!set[i].valid && victim == nullptr) {
+                victim = &set[i];
+            }
+        }
+        misses++;
+        if (victim == nullptr) {
+            if (replacement == TlbReplacement::Random) {
+                victim = &set[rng() % ways];
+            } else {
+                victim = set;
+                for (size_t i = 1; i < ways; ++i) {
+                    if (set[i].last_use < victim->last_use) {
+                        victim = &set[i];
+                    }
+                }
+            }
+        }
+        *victim = Entry{vpn, time, shift, true};
+        return false;
+    }
+
+    size_t hit_count() const { return hits; }
+    size_t miss_count() const { return misses; }
+};
+
+
+// Параметры TLB. Попадание в L1 DTLB совмещено с обращением к L1 и ничего
+// не стоит; промах платит поиск в общем L2 TLB и, при его промахе, обход таблиц
+struct TlbOptions {
+    size_t l1_entries = 64;
+    size_t l1_associativity = 4;
+    size_t l2_entries = 1536;
+    size_t l2_associativity = 12;
+    TlbReplacement replacement = TlbReplacement::Lru;
+    uint64_t l2_latency = 7;
+    uint64_t walk_latency = 30;
+    uint64_t seed = 1;
+};
+
+
+// Выделение физических кадров под виртуальные страницы
+enum class FrameAllocation {
+    Sequential,     // кадры подряд в порядке первого обращения
+    Random,         // случайный свободный кадр
+    Coloring,       // кадр того же цвета (номера сета L3 по модулю), что и виртуальная страница
+    HugeContiguous  // 2 МБ виртуальной памяти - в непрерывный выровненный случайный участок
+};
+
+bool parse_frame_allocation(const std::string& name, FrameAllocation& out) {
+    static const std::pair<const char*, FrameAllocation> names[] = {
+        {"sequential", FrameAllocation::Sequential},
+        {"random", FrameAllocation::Random},
+        {"coloring", FrameAllocation::Coloring},
+        {"huge_contiguous", FrameAllocation::HugeContiguous},
+    };
+    for (const auto& it : names) {
+        if (name == it.first) {
+            out = it.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Отображение виртуальных страниц 4 КБ в физические кадры. Кадры выделяются
+// при первом обращении к странице; если физическая память исчерпана, кадры
+// начинают повторяться (overcommitted)
+class PhysicalMemoryMap {
+private:
+    static const unsigned PAGE_SHIFT = 12;
+    static constexpr uint64_t HUGE_FRAMES = 512;
+
+    FrameAllocation allocation;
+    uint64_t total_frames;
+    uint64_t colors;
+    std::mt19937_64 random;
+    std::unordered_map<uint64_t, uint64_t> frames;       // виртуальная страница -> кадр
+    std::unordered_map<uint64_t, uint64_t> huge_chunks;  // номер 2 МБ области -> участок
+    std::vector<bool> used;                              // занятые кадры или участки
+    uint64_t next_frame;
+    std::vector<uint64_t> next_in_color;
+    size_t overcommitted;
+
+    // Свободный элемент used начиная со случайного места
+    uint64_t take_random(uint64_t count) {
+        uint64_t index = random() % count;
+        for (uint64_t step = 0; step < count; ++step, index = (index + 1) % count) {
+            if (!used[index]) {
+                used[index] = true;
+                return index;
+            }
+        }
+        overcommitted++;
+        return index;
+    }
+
+    uint64_t allocate(uint64_t page) {
+        switch (allocation) {
+        case FrameAllocation::Random:
+            return take_random(total_frames);
+        case FrameAllocation::Coloring: {
+            const uint64_t color = page % colors;
+            uint64_t frame = color + colors * next_in_color[color]++;
+            if (frame >= total_frames) {
+                overcommitted++;
+                frame %= total_frames;
+            }
+            return frame;
+        }
+        case FrameAllocation::HugeContiguous: {
+            auto it = huge_chunks.find(page / HUGE_FRAMES);
+            if (it == huge_chunks.end()) {
+                it = huge_chunks.emplace(page / HUGE_FRAMES, take_random(used.size())).first;
+            }
+            return it->second * HUGE_FRAMES + page % HUGE_FRAMES;
+        }
+        case FrameAllocation::Sequential:
+        default:
+            if (next_frame >= total_frames) {
+                overcommitted++;
+            }
+            return next_frame++ % total_frames;
+        }
+    }
+
+public:
+    // colors - число цветов страниц: сколько страниц помещается в один путь L3
+    explicit PhysicalMemoryMap(FrameAllocation allocation = FrameAllocation::Sequential,
+                               uint64_t memory_size = 16ULL << 30, uint64_t colors = 1, uint64_t seed = 1)
+        : allocation(allocation), colors(std::max<uint64_t>(colors, 1)), random(seed), next_frame(0),
+          overcommitted(0) {
+        total_frames = std::max<uint64_t>(memory_size >> PAGE_SHIFT, HUGE_FRAMES);
+        if (allocation == FrameAllocation::Random) {
+            used.assign(total_frames, false);
+        } else if (allocation == FrameAllocation::HugeContiguous) {
+            used.assign(total_frames / HUGE_FRAMES, false);
+        }
+        next_in_color.assign(this->colors, 0);
+    }
+
+    uint64_t translate(uint64_t address) {
+        const uint64_t page = address >> PAGE_SHIFT;
+        auto it = frames.find(page);
+        if (it == frames.end()) {
+            it = frames.emplace(page, allocate(page)).first;
+        }
+        return (it->second << PAGE_SHIFT) | (address & ((1ULL << PAGE_SHIFT) - 1));
+    }
+
+    void write_json(JsonWriter& json) const {
+        static const char* const names[] = {"sequential", "random", "coloring", "huge_contiguous"};
+        json.value("allocator", std::string(names[static_cast<size_t>(allocation)]));
+        json.value("physical_frames", total_frames);
+        json.value("page_colors", colors);
+        json.value("mapped_pages", frames.size());
+        json.value("huge_chunks", huge_chunks.size());
+        json.value("overcommitted_frames", overcommitted);
+    }
+};
+
+
+// Обходчик таблиц страниц: радиксное дерево из 4 или 5 уровней по 9 бит адреса.
+// Таблицы создаются при первом обращении в отдельной области адресов, сами
+// элементы читает иерархия кешей. Кеши обхода (PWC) хранят элементы нелистовых
+// уровней и позволяют начать обход ниже корня
+class PageWalker {
+public:
+    static const uint64_t TABLE_REGION = 1ULL << 60;  // начало области таблиц страниц
+    static const uint64_t TABLE_REGION_END = 1ULL << 61;
+
+private:
+    size_t levels;
+    std::vector<Tlb> pwc;                           // [0] - корневой уровень
+    std::unordered_map<uint64_t, uint64_t> tables;  // (префикс адреса, уровень) -> адрес таблицы
+    uint64_t next_table;
+    size_t walks;
+    size_t pte_reads;
+    std::vector<size_t> pwc_hits;
+
+    // Сдвиг адреса, биты над которым выбирают элемент таблицы уровня level (0 - корень)
+    unsigned level_shift(size_t level) const { return static_cast<unsigned>(12 + 9 * (levels - 1 - level)); }
+
+    uint64_t table_address(size_t level, uint64_t address) {
+        const uint64_t prefix = level == 0 ? 0 : address >> level_shift(level - 1);
+        auto it = tables.emplace((prefix << 3) | level, next_table);
+        if (it.second) {
+            next_table += 4096;
+        }
+        return it.first->second;
+    }
+
+public:
+    explicit PageWalker(size_t levels = 4, size_t pwc_entries = 32)
+        : levels(levels == 5 ? 5 : 4), next_table(TABLE_REGION), walks(0), pte_reads(0) {
+        if (pwc_entries > 0) {
+            for (size_t level = 0; level + 1 < this->levels; ++level) {
+                pwc.push_back(Tlb(pwc_entries, pwc_entries));
+            }
+        }
+        pwc_hits.assign(this->levels, 0);
+    }
+
+    // Адреса элементов, которые читает обход для страницы размера 2^shift
+    void walk(uint64_t address, unsigned shift, std::vector<uint64_t>& ptes) {
+        ptes.clear();
+        walks++;
+        // Большие страницы заканчивают обход на уровень (2 МБ) или два (1 ГБ) раньше
+        const size_t leaf = levels - 1 - std::min<size_t>((shift - 12) / 9, levels - 1);
+        size_t first = 0;
+        if (!pwc.empty()) {
+            for (size_t level = leaf; level-- > 0;) {
+                if (pwc[level].access(address, level_shift(level))) {
+                    pwc_hits[level]++;
+                    first = level + 1;
+                    break;
+                }
+            }
+        }
+        for (size_t level = first; level <= leaf; ++level) {
+            ptes.push_back(table_address(level, address) + ((address >> level_shift(level)) & 511) * 8);
+        }
+        pte_reads += ptes.size();
+    }
+
+    void write_json(JsonWriter& json) const {
+        json.value("levels", levels);
+        json.value("walks", walks);
+        json.value("pte_reads", pte_reads);
+        json.value("pte_reads_per_walk", walks ? static_cast<double>(pte_reads) / walks : 0.0);
+        json.value("table_pages", tables.size());
+        json.begin_array("pwc_hits");
+        for (size_t level = 0; level + 1 < levels; ++level) {
+            json.element(pwc_hits[level]);
+        }
+        json.end_array();
+    }
+};
+
+
+// Счетчики по отдельному потоку
+struct ThreadStats {
+    bool started;
+    size_t core;  // порядковый номер потока в трассе, он же номер ядра
+    Cache* l1;    // частный L1 данных потока (создается при первом обращении)
+    size_t accesses;  // обращения к данным (чтения, записи, атомарные)
+    size_t l1_hits, l1_misses;
+    size_t l2_hits, l2_misses;
+    size_t l3_hits, l3_misses;
+    uint64_t latency_cycles;  // суммарная задержка обращений
+    // Без модели MLP - задержка сверх попадания в L1, с ней - время ожидания
+    // свободного места в окне незавершенных промахов
+    uint64_t stall_cycles;
+
+    // Трансляция адресов
+    size_t dtlb_misses;
+    size_t page_walks;
+    uint64_t translation_cycles;
+
+    // Выборка инструкций
+    size_t ifetches;
+    size_t l1i_misses;
+    uint64_t ifetch_stall_cycles;
+
+    // Модель параллелизма памяти
+    uint64_t clock;                      // время выдачи следующего обращения
+    std::vector<uint64_t> outstanding;   // время готовности незавершенных промахов
+    MshrFile l1_mshr;
+    uint64_t miss_cycles;                // суммарная задержка промахов
+    uint64_t miss_busy_cycles;           // такты, когда был хотя бы один незавершенный промах
+    uint64_t miss_busy_until;
+
+    ThreadStats() : started(false), core(0), l1(nullptr), accesses(0), l1_hits(0), l1_misses(0), l2_hits(0), l2_misses(0),
+                    l3_hits(0), l3_misses(0), latency_cycles(0), stall_cycles(0),
+                    dtlb_misses(0), page_walks(0), translation_cycles(0),
+                    ifetches(0), l1i_misses(0), ifetch_stall_cycles(0), clock(0), miss_cycles(0), miss_busy_cycles(0), miss_busy_until(0) {}
+
+    double amat() const { return accesses ? static_cast<double>(latency_cycles) / accesses : 0.0; }
+
+    // Среднее число одновременно обслуживаемых промахов
+    double mlp() const { return miss_busy_cycles ? static_cast<double>(miss_cycles) / miss_busy_cycles : 0.0; }
+
+    // Оценка времени работы потока: выдача последнего обращения и завершение всех промахов
+    uint64_t total_cycles() const { return std::max(clock, miss_busy_until); }
+};
+
+// Смешивание нагрузок: номер нагрузки (идентификатор адресного пространства)
+// складывается по XOR со старшими битами адресов и PC и записывается в старшие
+// биты номера потока, так что одинаковые виртуальные адреса разных нагрузок не
+// совпадают, а их потоки попадают на разные ядра
+const unsigned WORKLOAD_ADDRESS_SHIFT = 48;
+const unsigned WORKLOAD_THREAD_SHIFT = 32;
+
+// Итоги по потокам одной нагрузки
+struct WorkloadStats {
+    size_t threads;
+    size_t accesses;
+    size_t l3_misses;
+    uint64_t latency_cycles;
+    uint64_t cycles;  // время работы самого долгого потока
+
+    WorkloadStats() : threads(0), accesses(0), l3_misses(0), latency_cycles(0), cycles(0) {}
+
+    double amat() const { return accesses ? static_cast<double>(latency_cycles) / accesses : 0.0; }
+};
+
+
+// Задержки уровней в тактах. Обращение платит задержки всех пройденных уровней
+// (последовательный поиск), к L3 добавляется задержка сети до слайса
+struct LatencyOptions {
+    uint64_t l1 = 4;
+    uint64_t l2 = 14;
+    uint64_t l3 = 40;
+    uint64_t memory = 200;
+};
+
+
+struct PcStats {
+    uint64_t accesses;
+    uint64_t stall_cycles;
+
+    PcStats() : accesses(0), stall_cycles(0) {}
+};
+
+
+class CacheHierarchy {
+private:
+    std::shared_ptr<Arena> arena;  // линии всех кешей (nullptr - у каждого кеша своя арена)
+    std::map<uint64_t, Cache> l1_caches;  // по одному на поток
+    Cache l2_cache;
+    SlicedCache l3_cache;
+
+    size_t l1_size;
+    size_t l1_line_size;
+    size_t l1_associativity;
+    CacheOptions l1_options;
+
+    std::map<uint64_t, ThreadStats> thread_stats;
+    uint64_t last_thread_id;    // поток последнего обращения
+    ThreadStats* last_thread;
+
+    // Дистанция повторного использования: число обращений между
+    // двумя соседними обращениями к одной и той же линии (гранулярность L1)
+    bool track_reuse_distance;
+    uint64_t access_index;
+    std::unordered_map<uint64_t, uint64_t> last_line_access;
+    Histogram reuse_distance;
+
+    // Модель задержек
+    LatencyOptions latency;
+    Histogram latency_histogram;
+    bool track_pc_stalls;
+    std::unordered_map<uint64_t, PcStats> pc_stats;
+
+    // Модель параллелизма памяти
+    MlpOptions mlp;
+    MshrFile l2_mshr;
+    MshrFile l3_mshr;
+
+    // Память за L3
+    bool dram_enabled;
+    DramModel dram;
+    bool tiers_enabled;
+    TieredMemory tiered;
+    bool memory_cache_enabled;
+    MemorySideCache memory_cache;
+    size_t memory_reads;
+    size_t memory_writebacks;
+
+    // TLB: L1 DTLB у каждого ядра и общий L2 TLB
+    bool tlb_enabled;
+    TlbOptions tlb_options;
+    PageSizeMap page_sizes;
+    std::map<uint64_t, Tlb> l1_tlbs;
+    Tlb l2_tlb;
+    size_t walks_by_page_size[3];  // 4 КБ, 2 МБ, 1 ГБ
+
+    // Обход таблиц страниц через иерархию кешей
+    bool walker_enabled;
+    PageWalker walker;
+    std::vector<uint64_t> walk_ptes;
+
+    // Трансляция в физические адреса для L2, L3 и памяти. L1 при VIPT
+    // индексируется виртуальным адресом, а тег берет из физического
+    bool physical_enabled;
+    bool l1_vipt;
+    PhysicalMemoryMap physical;
+
+    // L1-I у каждого ядра, поток выборки - PC записей трассы
+    struct FetchUnit {
+        Cache cache;
+        uint64_t last_line;
+        std::unordered_set<uint64_t> prefetched;  // линии, загруженные предвыборкой и еще не выбранные
+        size_t fetches, misses;
+        size_t prefetches, useful_prefetches;
+    };
+    bool icache_enabled;
+    size_t l1i_size, l1i_line_size, l1i_associativity;
+    bool icache_unified;   // промахи L1-I идут в общие L2/L3
+    bool icache_prefetch;  // предвыборка следующей линии
+    std::map<uint64_t, FetchUnit> fetch_units;
+    std::unordered_set<uint64_t> code_lines;  // линии, выбранные как инструкции
+
+    // Выборка линии с инструкцией pc; возвращает простой из-за промаха L1-I
+    uint64_t fetch(ThreadStats& thread, uint64_t thread_id, uint64_t pc) {
+        auto it = fetch_units.find(thread_id);
+        if (it == fetch_units.end()) {
+            CacheOptions options;
+            options.seed += thread_id;
+            options.arena = arena.get();
+            it = fetch_units.emplace(thread_id, FetchUnit{Cache(l1i_size, l1i_line_size, l1i_associativity, false,
+                                                                options),
+                                                          UINT64_MAX, {}, 0, 0, 0, 0}).first;
+        }
+        FetchUnit& unit = it->second;
+
+        // Повторная выборка из той же линии обслуживается буфером выборки
+        const uint64_t address = (physical_enabled ? physical.translate(pc) : pc) / l1i_line_size * l1i_line_size;
+        if (address == unit.last_line) {
+            return 0;
+        }
+        unit.last_line = address;
+        unit.fetches++;
+        thread.ifetches++;
+        if (unit.prefetched.erase(address)) {
+            unit.useful_prefetches++;
+        }
+
+        uint64_t cycles = 0;
+        if (icache_unified) {
+            code_lines.insert(address);
+            uint64_t interconnect;
+            const int hit_level = lookup(thread, unit.cache, address, address, pc, AccessKind::Ifetch, interconnect);
+            const uint64_t level_latency[3] = {0, latency.l2, latency.l3 + interconnect};
+            for (int level = 0; level < hit_level && level < 3; ++level) {
+                cycles += level_latency[level];
+            }
+            if (hit_level == 4) {
+                cycles += memory_latency(thread, address, thread.clock + cycles);
+            }
+        } else if (!unit.cache.access(address, true, pc)) {
+            // Без общих уровней промах L1-I считается попаданием в L2
+            cycles = latency.l2;
+        }
+        if (cycles > 0) {
+            unit.misses++;
+            thread.l1i_misses++;
+        }
+
+        if (icache_prefetch) {
+            const uint64_t next = address + l1i_line_size;
+            if (!unit.cache.access(next, false)) {
+                unit.prefetches++;
+                if (unit.prefetched.size() > 4 * l1i_size / l1i_line_size) {
+                    unit.prefetched.clear();
+                }
+                unit.prefetched.insert(next);
+                if (icache_unified) {
+                    // Предвыборка идет вниз тем же путем, что и промах выборки,
+                    // и занимает память, но поток ее не ждет. В статистику
+                    // обращений к L2 и L3 она не входит, ее считает сам L1-I
+                    code_lines.insert(next);
+                    uint64_t interconnect;
+                    if (lookup_shared(thread, unit.cache, next, next, pc, interconnect, false) == 4) {
+                        memory_latency(thread, next, thread.clock);
+                    }
+                }
+            }
+        }
+
+        // Простой выборки задерживает выдачу следующих обращений потока
+        thread.ifetch_stall_cycles += cycles;
+        thread.clock += cycles;
+        return cycles;
+    }
+
+    // Где нашлись данные для каждого вида обращений
+    struct KindStats {
+        size_t accesses;
+        size_t hits[4];     // L1, L2, L3, память
+        size_t writebacks;  // записи в память (clflush, clwb, некешируемые записи)
+    };
+    KindStats kind_stats[static_cast<size_t>(AccessKind::Count)];
+
+    // Согласованность частных L1
+    bool coherence_enabled;
+    size_t coherence_invalidations;  // копии, снятые чужой записью
+    size_t coherence_transfers;      // грязные копии, переданные другому ядру
+
+    // Насколько записей вперед access_batch() запрашивает сеты
+    static const size_t BATCH_PREFETCH_DISTANCE = 8;
+
+    // Сеты записи пакета, вычисленные до его обработки; l1 = SIZE_MAX - не известен
+    struct BatchSets {
+        size_t l1, l2, l3_slice, l3;
+    };
+    std::vector<BatchSets> batch_sets;
+
+    // Сеты всех записей пакета. Геометрия и функция индекса у всех L1 одинаковы,
+    // поэтому сет L1 считается по L1 потока последнего обращения, если он уже есть
+    void compute_batch_sets(const LogEntry* entries, size_t count) {
+        const Cache* l1 = last_thread != nullptr ? last_thread->l1 : nullptr;
+        batch_sets.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            const uint64_t address = entries[i].address;
+            BatchSets& sets = batch_sets[i];
+            sets.l1 = l1 != nullptr ? l1->set_of(address) : SIZE_MAX;
+            sets.l2 = l2_cache.set_of(address);
+            sets.l3_slice = l3_cache.slice_of(address);
+            sets.l3 = l3_cache.set_of(address, sets.l3_slice);
+        }
+    }
+
+    // Предвыборка сетов, к которым обратится запись i пакета. L1 - только для
+    // потока последнего обращения (без поиска в std::map)
+    void prefetch_sets(const LogEntry* entries, size_t i, bool header) const {
+        const BatchSets& sets = batch_sets[i];
+        if (sets.l1 != SIZE_MAX && entries[i].thread_id == last_thread_id && last_thread->l1 != nullptr) {
+            last_thread->l1->prefetch_set(sets.l1, header);
+        }
+        l2_cache.prefetch_set(sets.l2, header);
+        l3_cache.prefetch_set(sets.l3_slice, sets.l3, header);
+    }
+
+    // Запись с аннулированием между частными L1: запись снимает копии линии в
+    // остальных L1, промах чтения забирает грязную копию другого ядра. Грязные
+    // данные проходят через L2, чтобы запросившее ядро нашло их там
+    void snoop(ThreadStats& thread, const Cache& l1, uint64_t l1_address, uint64_t address, bool is_write) {
+        for (auto& it : l1_caches) {
+            Cache& other = it.second;
+            bool dirty;
+            if (&other == &l1 || !other.probe(address, l1_address, dirty)) {
+                continue;
+            }
+            if (is_write) {
+                other.invalidate(address, l1_address);
+                coherence_invalidations++;
+            } else if (dirty) {
+                other.clean(address, l1_address);
+            }
+            if (dirty) {
+                coherence_transfers++;
+                l2_cache.access(address, false, 0, thread.core, true);
+                write_back_from_l2(thread);
+            }
+        }
+    }
+
+    // Обход таблиц для промаха TLB в момент arrival: элементы читаются
+    // последовательно, каждый - через кеши (L1 потока уже создан в access()).
+    // Возвращает задержку обхода
+    uint64_t walk(ThreadStats& thread, uint64_t address, unsigned shift, uint64_t arrival) {
+        walker.walk(address, shift, walk_ptes);
+        Cache& l1 = *thread.l1;
+        uint64_t cycles = 0;
+        for (uint64_t pte : walk_ptes) {
+            uint64_t interconnect;
+            const int hit_level = lookup(thread, l1, pte, pte, 0, AccessKind::PageWalk, interconnect);
+            const uint64_t level_latency[3] = {latency.l1, latency.l2, latency.l3 + interconnect};
+            for (int level = 0; level < hit_level && level < 3; ++level) {
+                cycles += level_latency[level];
+            }
+            if (hit_level == 4) {
+                cycles += memory_latency(thread, pte, arrival + cycles);
+            }
+        }
+        return cycles;
+    }
+
+    // Задержка трансляции сверх попадания в L1 DTLB
+    uint64_t translate(ThreadStats& thread, uint64_t thread_id, uint64_t address) {
+        const unsigned shift = page_sizes.page_shift(address);
+        auto it = l1_tlbs.find(thread_id);
+        if (it == l1_tlbs.end()) {
+            it = l1_tlbs.emplace(thread_id, Tlb(tlb_options.l1_entries, tlb_options.l1_associativity,
+                                                tlb_options.replacement, tlb_options.seed + thread_id)).first;
+        }
+        if (it->second.access(address, shift)) {
+            return 0;
+        }
+        thread.dtlb_misses++;
+        uint64_t cycles = tlb_options.l2_latency;
+        if (!l2_tlb.access(address, shift)) {
+            thread.page_walks++;
+            walks_by_page_size[shift >= 30 ? 2 : shift >= 21 ? 1 : 0]++;
+            cycles += walker_enabled ? walk(thread, address, shift, thread.clock + cycles)
+                                     : tlb_options.walk_latency;
+        }
+        thread.translation_cycles += cycles;
+        return cycles;
+    }
+
+    // Задержка чтения из памяти запроса, пришедшего в момент arrival:
+    // сначала путь до уровня памяти страницы, затем сама DRAM
+    uint64_t backing_latency(const ThreadStats& thread, uint64_t address, uint64_t arrival) {
+        memory_reads++;
+        const uint64_t tier_cycles = tiers_enabled ? tiered.access(address, thread.core, arrival, false) : 0;
+        return tier_cycles + (dram_enabled ? dram.access(address, arrival + tier_cycles, false) : latency.memory);
+    }
+
+    void backing_write(const ThreadStats& thread, uint64_t address) {
+        memory_writebacks++;
+        const uint64_t tier_cycles = tiers_enabled ? tiered.access(address, thread.core, thread.clock, true) : 0;
+        if (dram_enabled) {
+            dram.access(address, thread.clock + tier_cycles, true);
+        }
+    }
+
+    // Промах L3: кеш на стороне памяти, если он есть, затем память
+    uint64_t memory_latency(const ThreadStats& thread, uint64_t address, uint64_t arrival) {
+        if (!memory_cache_enabled) {
+            return backing_latency(thread, address, arrival);
+        }
+        const bool hit = memory_cache.access(address, false);
+        write_back_from_memory_cache(thread);
+        if (hit) {
+            return memory_cache.hit_latency();
+        }
+        const uint64_t probe = memory_cache.probe_latency();
+        const uint64_t cycles = probe + backing_latency(thread, address, arrival + probe);
+        // Остальные линии блока читаются из памяти вслед за запрошенной
+        const uint64_t line = memory_cache.line_size();
+        const uint64_t block = address / memory_cache.block_size() * memory_cache.block_size();
+        for (uint64_t offset = 0; offset < memory_cache.block_size(); offset += line) {
+            if (block + offset != address / line * line) {
+                backing_latency(thread, block + offset, arrival + probe);
+            }
+        }
+        return cycles;
+    }
+
+    // Грязный блок кеша на стороне памяти записывается в память по линиям
+    void write_back_from_memory_cache(const ThreadStats& thread) {
+        uint64_t block;
+        if (memory_cache.take_writeback(block)) {
+            for (uint64_t offset = 0; offset < memory_cache.block_size(); offset += memory_cache.line_size()) {
+                backing_write(thread, block + offset);
+            }
+        }
+    }
+
+    // Грязные линии, вытесненные с уровня, записываются на уровень ниже
+    void write_back_from_l1(Cache& l1, ThreadStats& thread) {
+        uint64_t victim;
+        if (l1.take_writeback(victim)) {
+            l2_cache.access(victim, false, 0, thread.core, true);
+            write_back_from_l2(thread);
+        }
+    }
+
+    void write_back_from_l2(ThreadStats& thread) {
+        uint64_t victim;
+        if (l2_cache.take_writeback(victim)) {
+            l3_cache.access(victim, false, 0, thread.core, thread.core, true);
+            write_back_from_l3(thread);
+        }
+    }
+
+    void write_back_from_l3(ThreadStats& thread) {
+        uint64_t victim;
+        if (l3_cache.take_writeback(victim)) {
+            write_to_memory(thread, victim);
+        }
+    }
+
+    void write_to_memory(const ThreadStats& thread, uint64_t address) {
+        // Запись мимо кеша на стороне памяти, если линии в нем нет
+        if (!memory_cache_enabled || !memory_cache.access(address, true)) {
+            backing_write(thread, address);
+        }
+    }
+
+    // clflush и некешируемая запись снимают линию со всех уровней, включая L1-I,
+    // clwb только очищает ее. Грязные данные и данные некешируемой записи уходят в память
+    void maintain(ThreadStats& thread, uint64_t l1_address, uint64_t address, AccessKind kind) {
+        const bool keep = kind == AccessKind::Clwb;
+        bool dirty = false;
+        for (auto& it : l1_caches) {
+            dirty |= keep ? it.second.clean(address, l1_address) : it.second.invalidate(address, l1_address);
+        }
+        // В L1-I не бывает грязных линий, clwb ее не затрагивает
+        for (auto it = fetch_units.begin(); !keep && it != fetch_units.end(); ++it) {
+            FetchUnit& unit = it->second;
+            unit.cache.invalidate(address);
+            // Снятую линию нельзя выбрать и из буфера выборки
+            if (unit.last_line == address / l1i_line_size * l1i_line_size) {
+                unit.last_line = UINT64_MAX;
+            }
+        }
+        dirty |= keep ? l2_cache.clean(address) : l2_cache.invalidate(address);
+        dirty |= keep ? l3_cache.clean(address) : l3_cache.invalidate(address);
+
+        KindStats& stats = kind_stats[static_cast<size_t>(kind)];
+        stats.accesses++;
+        if (dirty || kind == AccessKind::NtStore) {
+            stats.writebacks++;
+            write_to_memory(thread, address);
+        }
+    }
+
+    // Промах l1: поиск в L2 и L3 с заполнением вышележащих уровней, включая l1.
+    // count_cache = false - предвыборка, не учитываемая в статистике L2 и L3.
+    // Возвращает уровень, на котором нашлись данные: 2, 3 или 4 (память)
+    int lookup_shared(ThreadStats& thread, Cache& l1, uint64_t l1_address, uint64_t address, uint64_t pc,
+                      uint64_t& interconnect, bool count_cache = true) {
+        // Группа для разделения путей общих уровней определяется по ядру
+        const size_t group = thread.core;
+        interconnect = 0;
+        if (l2_cache.access(address, count_cache, pc, group)) {
+            write_back_from_l2(thread);
+            // При попадании в L2 подгружаем также в L1
+            l1.access_indexed(address, l1_address, false);
+            write_back_from_l1(l1, thread);
+            return 2;
+        }
+        write_back_from_l2(thread);
+        bool l3_hit = l3_cache.access(address, count_cache, pc, group, thread.core);
+        interconnect = l3_cache.last_interconnect_latency();
+        write_back_from_l3(thread);
+
+        // При промахе L3 данные подгружаются из памяти во все уровни кэша
+        l2_cache.access(address, false, pc, group);
+        write_back_from_l2(thread);
+        l1.access_indexed(address, l1_address, false);
+        write_back_from_l1(l1, thread);
+        return l3_hit ? 3 : 4;
+    }
+
+    // Проходит уровни кешей, при промахе заполняя верхние уровни; l1_address -
+    // адрес, по которому L1 выбирает сет, address - адрес линии на всех уровнях.
+    // Возвращает уровень, на котором нашлись данные (4 - память)
+    int lookup(ThreadStats& thread, Cache& l1, uint64_t l1_address, uint64_t address, uint64_t pc, AccessKind kind,
+               uint64_t& interconnect) {
+        interconnect = 0;
+        const bool is_write = kind == AccessKind::Store || kind == AccessKind::Atomic;
+        bool l1_hit = l1.access_indexed(address, l1_address, true, pc, 0, is_write);
+        write_back_from_l1(l1, thread);
+        if (coherence_enabled && (is_write || !l1_hit)) {
+            snoop(thread, l1, l1_address, address, is_write);
+        }
+        const int hit_level = l1_hit ? 1 : lookup_shared(thread, l1, l1_address, address, pc, interconnect);
+
+        KindStats& stats = kind_stats[static_cast<size_t>(kind)];
+        stats.accesses++;
+        stats.hits[hit_level - 1]++;
+        return hit_level;
+    }
+
+    // hit_level - уровень, на котором нашлись данные (4 - память),
+    // translation - задержка трансляции, предшествующая обращению к кешам
+    uint64_t finish_access(ThreadStats& thread, uint64_t pc, uint64_t address, int hit_level, uint64_t interconnect,
+                           uint64_t translation, AccessKind kind) {
+        const uint64_t level_latency[3] = {latency.l1, latency.l2, latency.l3 + interconnect};
+        uint64_t cycles = translation;
+        uint64_t stall = 0;
+        if (mlp.enabled) {
+            cycles = schedule_access(thread, address, hit_level, level_latency, translation,
+                                     kind == AccessKind::Atomic, stall);
+        } else {
+            // Без модели MLP поток блокируется на каждом обращении
+            for (int level = 0; level < hit_level && level < 3; ++level) {
+                cycles += level_latency[level];
+            }
+            if (hit_level == 4) {
+                cycles += memory_latency(thread, address, thread.clock + cycles);
+            }
+            stall = cycles - latency.l1;
+            thread.clock += cycles;
+        }
+
+        thread.latency_cycles += cycles;
+        thread.stall_cycles += stall;
+        latency_histogram.add(cycles);
+        if (track_pc_stalls) {
+            PcStats& stats = pc_stats[pc];
+            stats.accesses++;
+            stats.stall_cycles += stall;
+        }
+        return cycles;
+    }
+
+    // Обращение выдается в момент thread.clock; промах проходит уровни вниз,
+    // занимая MSHR каждого пройденного уровня либо присоединяясь к уже идущей
+    // загрузке той же линии. Трансляция задерживает выдачу этого и следующих
+    // обращений. Возвращает задержку от выдачи до готовности данных,
+    // в stall - такты ожидания места в окне перед выдачей
+    uint64_t schedule_access(ThreadStats& thread, uint64_t address, int hit_level, const uint64_t* level_latency,
+                             uint64_t translation, bool serialize, uint64_t& stall) {
+        const uint64_t line = address / l1_line_size;
+        uint64_t issue = thread.clock;
+        auto& outstanding = thread.outstanding;
+        auto retire = [&](uint64_t now) {
+            outstanding.erase(std::remove_if(outstanding.begin(), outstanding.end(),
+                                             [now](uint64_t ready) { return ready <= now; }),
+                              outstanding.end());
+        };
+        retire(issue);
+        stall = 0;
+        if (serialize && !outstanding.empty()) {
+            // Атомарная операция ждет завершения всех предыдущих промахов, как барьер
+            const uint64_t last = *std::max_element(outstanding.begin(), outstanding.end());
+            stall = last - issue;
+            issue = last;
+            retire(issue);
+        } else if (outstanding.size() >= mlp.issue_window) {
+            uint64_t earliest = *std::min_element(outstanding.begin(), outstanding.end());
+            stall = earliest - issue;
+            issue = earliest;
+            retire(issue);
+        }
+        const uint64_t start = issue;
+        issue += translation;
+
+        MshrFile* files[3] = {&thread.l1_mshr, &l2_mshr, &l3_mshr};
+        uint64_t now = issue;
+        uint64_t ready = 0;
+        int allocated = 0;
+        for (int level = 0; ; ++level) {
+            uint64_t pending;
+            if (level < 3 && files[level]->find(line, now, pending)) {
+                ready = std::max(now + level_latency[level], pending);
+                break;
+            }
+            if (level + 1 >= hit_level) {
+                ready = now + (level == 3 ? memory_latency(thread, address, now) : level_latency[level]);
+                break;
+            }
+            now = files[level]->reserve(now) + level_latency[level];
+            allocated = level + 1;
+        }
+        for (int level = 0; level < allocated; ++level) {
+            files[level]->insert(line, ready);
+        }
+
+        thread.clock = issue + mlp.issue_cycles;
+        if (ready - issue > latency.l1) {
+            outstanding.push_back(ready);
+            // Отрезки промахов начинаются в неубывающие моменты, поэтому объединение считается за один проход
+            thread.miss_cycles += ready - issue;
+            if (issue >= thread.miss_busy_until) {
+                thread.miss_busy_cycles += ready - issue;
+                thread.miss_busy_until = ready;
+            } else if (ready > thread.miss_busy_until) {
+                thread.miss_busy_cycles += ready - thread.miss_busy_until;
+                thread.miss_busy_until = ready;
+            }
+        }
+        return ready - start;
+    }
+
+    // Настройки уровня с ареной иерархии (если она задана)
+    static CacheOptions with_arena(CacheOptions options, Arena* arena) {
+        if (arena != nullptr) {
+            options.arena = arena;
+        }
+        return options;
+    }
+
+public:
+    CacheHierarchy(
+        size_t num_cores,
+        size_t l1_size, size_t l1_line_size, size_t l1_associativity,
+        size_t l2_size, size_t l2_line_size, size_t l2_associativity,
+        size_t l3_size, size_t l3_line_size, size_t l3_associativity,
+        const CacheOptions& l1_options = CacheOptions(),
+        const CacheOptions& l2_options = CacheOptions(),
+        const CacheOptions& l3_options = CacheOptions(),
+        const NucaOptions& l3_nuca = NucaOptions(),
+        const std::shared_ptr<Arena>& arena = nullptr
+    ) : arena(arena), l2_cache(l2_size, l2_line_size, l2_associativity, true, with_arena(l2_options, arena.get())),
+        l3_cache(num_cores, l3_size, l3_line_size, l3_associativity, with_arena(l3_options, arena.get()), l3_nuca),
+        l1_size(l1_size), l1_line_size(l1_line_size), l1_associativity(l1_associativity),
+        l1_options(with_arena(l1_options, arena.get())), last_thread_id(0), last_thread(nullptr), track_reuse_distance(false), access_index(0), track_pc_stalls(false),
+        dram_enabled(false), tiers_enabled(false), memory_cache_enabled(false), memory_reads(0),
+        memory_writebacks(0), tlb_enabled(false), walks_by_page_size(), walker_enabled(false),
+        physical_enabled(false), l1_vipt(true), icache_enabled(false), l1i_size(0),
+        l1i_line_size(64), l1i_associativity(1), icache_unified(true), icache_prefetch(true), kind_stats(),
+        coherence_enabled(false), coherence_invalidations(0), coherence_transfers(0) {
+    }
+
+    void enable_reuse_distance(bool enable) { track_reuse_distance = enable; }
+    void enable_coherence(bool enable) { coherence_enabled = enable; }
+    void set_latencies(const LatencyOptions& options) { latency = options; }
+    void enable_pc_stalls(bool enable) { track_pc_stalls = enable; }
+
+    void set_mlp(const MlpOptions& options) {
+        mlp = options;
+        mlp.issue_window = std::max<size_t>(mlp.issue_window, 1);
+        l2_mshr = MshrFile(mlp.l2_mshrs);
+        l3_mshr = MshrFile(mlp.l3_mshrs);
+    }
+
+    void set_dram(const DramOptions& options) {
+        dram_enabled = true;
+        dram = DramModel(options);
+    }
+
+    void set_tiers(const TierOptions& options) {
+        tiers_enabled = true;
+        tiered = TieredMemory(options);
+    }
+
+    void set_memory_cache(const MemoryCacheOptions& options) {
+        memory_cache_enabled = true;
+        memory_cache = MemorySideCache(options);
+    }
+
+    void set_tlb(const TlbOptions& options, const PageSizeMap& sizes) {
+        tlb_enabled = true;
+        tlb_options = options;
+        page_sizes = sizes;
+        l2_tlb = Tlb(options.l2_entries, options.l2_associativity, options.replacement, options.seed);
+    }
+
+    void set_physical_map(const PhysicalMemoryMap& map, bool vipt) {
+        physical_enabled = true;
+        physical = map;
+        l1_vipt = vipt;
+        l1_options.virtual_index = vipt;
+    }
+
+    void set_icache(size_t size, size_t line_size, size_t associativity, bool unified, bool prefetch) {
+        icache_enabled = true;
+        l1i_size = size;
+        l1i_line_size = std::max<size_t>(line_size, 1);
+        l1i_associativity = associativity;
+        icache_unified = unified;
+        icache_prefetch = prefetch;
+    }
+
+    // Промахи L2 TLB обходят таблицы страниц через кеши вместо фиксированной задержки
+    void set_page_walker(size_t levels, size_t pwc_entries) {
+        walker_enabled = true;
+        walker = PageWalker(levels, pwc_entries);
+    }
+
+    // Закрепляет поток за следующим свободным ядром (иначе это происходит при его первом обращении)
+    ThreadStats& bind_thread(uint64_t thread_id) {
+        // Подряд идущие обращения одного потока обходятся без поиска в std::map
+        if (last_thread != nullptr && thread_id == last_thread_id) {
+            return *last_thread;
+        }
+        ThreadStats& thread = thread_stats[thread_id];
+        if (!thread.started) {
+            thread.started = true;
+            thread.core = thread_stats.size() - 1;
+            thread.l1_mshr = MshrFile(mlp.l1_mshrs);
+        }
+        last_thread_id = thread_id;
+        last_thread = &thread;
+        return thread;
+    }
+
+    // pc - адрес инструкции (return_address из трассы), используется предсказателями.
+    // Запись помечает линию в L1 грязной, вытесненные грязные линии записываются
+    // на следующий уровень. Возвращает задержку обращения в тактах
+    uint64_t access(uint64_t address, uint64_t thread_id, uint64_t pc = 0, AccessKind kind = AccessKind::Load) {
+        ThreadStats& thread = bind_thread(thread_id);
+        const bool demand = kind == AccessKind::Load || kind == AccessKind::Store || kind == AccessKind::Atomic;
+        if (demand) {
+            thread.accesses++;
+            access_index++;
+        }
+
+        if (demand && track_reuse_distance) {
+            auto it = last_line_access.emplace(address / l1_line_size, access_index);
+            if (!it.second) {
+                reuse_distance.add(access_index - it.first->second - 1);
+                it.first->second = access_index;
+            }
+        }
+
+        // Пробуем L1 // Берем L1-data кеш, L1-I (если включен) обслуживает выборку в fetch()
+        // Предполагаем, что каждый поток на отдельном ядре
+        if (thread.l1 == nullptr) {
+            auto it = l1_caches.find(thread_id);
+            if (it == l1_caches.end()) {
+                CacheOptions options = l1_options;
+                options.seed += thread_id;
+                it = l1_caches.emplace(thread_id, Cache(l1_size, l1_line_size, l1_associativity, false, options)).first;
+            }
+            thread.l1 = &it->second;
+        }
+        Cache& l1 = *thread.l1;
+
+        if (icache_enabled && pc != 0) {
+            fetch(thread, thread_id, pc);
+        }
+        if (kind == AccessKind::Ifetch) {
+            // Явная запись о выборке: адрес - адрес инструкции
+            return icache_enabled ? fetch(thread, thread_id, address) : 0;
+        }
+
+        const uint64_t translation = tlb_enabled ? translate(thread, thread_id, address) : 0;
+
+        // L1 при VIPT выбирает сет по виртуальному адресу: биты индекса внутри
+        // страницы у него те же, что у физического, выше (когда путь L1 больше
+        // страницы) - свои. Тег - весь физический адрес линии, по нему же
+        // пишутся вытесненные грязные линии
+        uint64_t l1_address = address;
+        if (physical_enabled) {
+            address = physical.translate(l1_address);
+            if (!l1_vipt) {
+                l1_address = address;
+            }
+        }
+
+        uint64_t interconnect;
+        if (kind == AccessKind::NtStore || kind == AccessKind::Flush || kind == AccessKind::Clwb) {
+            maintain(thread, l1_address, address, kind);
+            return translation;
+        }
+        if (kind == AccessKind::Prefetch) {
+            // Предвыборка заполняет уровни и занимает память, но поток ее не ждет
+            if (lookup(thread, l1, l1_address, address, pc, kind, interconnect) == 4) {
+                memory_latency(thread, address, thread.clock);
+            }
+            return translation;
+        }
+
+        const int hit_level = lookup(thread, l1, l1_address, address, pc, kind, interconnect);
+        if (hit_level == 1) {
+            thread.l1_hits++;
+        } else {
+            thread.l1_misses++;
+            if (hit_level == 2) {
+                thread.l2_hits++;
+            } else {
+                thread.l2_misses++;
+                (hit_level == 3 ? thread.l3_hits : thread.l3_misses)++;
+            }
+        }
+        return finish_access(thread, pc, address, hit_level, interconnect, translation, kind);
+    }
+
+    // Обрабатывает записи по порядку так же, как последовательные вызовы access();
+    // timestamp записи - самый ранний такт выдачи обращения (0 - не задан).
+    // Сеты всех записей вычисляются заранее; пока обрабатывается запись i, сеты
+    // записи i + BATCH_PREFETCH_DISTANCE загружаются в кеш хоста, скрывая его
+    // промахи на больших моделируемых кешах. При трансляции в физические адреса
+    // сеты заранее неизвестны, и предвыборка не делается
+    void access_batch(const LogEntry* entries, size_t count) {
+        const size_t prefetched = physical_enabled ? 0 : count;
+        if (prefetched != 0) {
+            compute_batch_sets(entries, count);
+        }
+        for (size_t i = 0; i < prefetched && i < 2 * BATCH_PREFETCH_DISTANCE; ++i) {
+            prefetch_sets(entries, i, i >= BATCH_PREFETCH_DISTANCE);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (i + 2 * BATCH_PREFETCH_DISTANCE < prefetched) {
+                prefetch_sets(entries, i + 2 * BATCH_PREFETCH_DISTANCE, true);
+            }
+            if (i + BATCH_PREFETCH_DISTANCE < prefetched) {
+                prefetch_sets(entries, i + BATCH_PREFETCH_DISTANCE, false);
+            }
+            const LogEntry& entry = entries[i];
+            if (entry.timestamp != 0) {
+                advance_clock(entry.thread_id, entry.timestamp);
+            }
+            access(entry.address, entry.thread_id, entry.return_address, entry.kind);
+        }
+    }
+
+    // Самый ранний момент выдачи следующего обращения потока (время из трассы)
+    void advance_clock(uint64_t thread_id, uint64_t time) {
+        ThreadStats& thread = bind_thread(thread_id);
+        thread.clock = std::max(thread.clock, time);
+    }
+
+    void coherence_statistics(size_t& invalidations, size_t& transfers) const {
+        invalidations = coherence_invalidations;
+        transfers = coherence_transfers;
+    }
+
+    WorkloadStats workload_statistics(size_t workload) const {
+        WorkloadStats stats;
+        for (const auto& it : thread_stats) {
+            if ((it.first >> WORKLOAD_THREAD_SHIFT) != workload) {
+                continue;
+            }
+            stats.threads++;
+            stats.accesses += it.second.accesses;
+            stats.l3_misses += it.second.l3_misses;
+            stats.latency_cycles += it.second.latency_cycles;
+            stats.cycles = std::max(stats.cycles, it.second.total_cycles());
+        }
+        return stats;
+    }
+
+    // Итоги модели задержек по всем потокам
+    void total_latency(uint64_t& accesses, uint64_t& latency_cycles, uint64_t& stall_cycles) const {
+        accesses = latency_cycles = stall_cycles = 0;
+        for (const auto& it : thread_stats) {
+            accesses += it.second.accesses;
+            latency_cycles += it.second.latency_cycles;
+            stall_cycles += it.second.stall_cycles;
+        }
+    }
+
+    double amat() const {
+        uint64_t accesses, latency_cycles, stall_cycles;
+        total_latency(accesses, latency_cycles, stall_cycles);
+        return accesses ? static_cast<double>(latency_cycles) / accesses : 0.0;
+    }
+
+    void print_statistics() {
+        size_t l1_hits = 0, l1_misses = 0;
+        size_t l2_hits = 0, l2_misses = 0;
+        size_t l3_hits = 0, l3_misses = 0;
+
+        for (const auto& l1 : l1_caches) {
+            size_t hits, misses;
+            l1.second.get_statistics(hits, misses);
+            l1_hits += hits;
+            l1_misses += misses;
+        }
+
+        l2_cache.get_statistics(l2_hits, l2_misses);
+        l3_cache.get_statistics(l3_hits, l3_misses);
+
+        std::cout << "Cache Statistics:\n"
+                  << "L1: " << l1_hits << " hits, " << l1_misses << " misses\n"
+                  << "L2: " << l2_hits << " hits, " << l2_misses << " misses\n"
+                  << "L3: " << l3_hits << " hits, " << l3_misses << " misses\n";
+    }
+
+    void write_heatmap_csv(std::ostream& out) const {
+        out << "level,set,accesses,misses\n";
+        for (const auto& l1 : l1_caches) {
+            l1.second.write_heatmap_csv(out, "l1_core" + std::to_string(thread_stats.at(l1.first).core));
+        }
+        l2_cache.write_heatmap_csv(out, "l2");
+        l3_cache.write_heatmap_csv(out, "l3");
+    }
+
+    // Память хоста под модели кешей по уровням (линии выделяются по мере касания)
+    void write_host_memory_json(JsonWriter& json) const {
+        size_t l1_bytes = 0, l1_allocated = 0, l1_lines = 0;
+        for (const auto& it : l1_caches) {
+            l1_bytes += it.second.host_memory_bytes();
+            l1_allocated += it.second.allocated_line_count();
+            l1_lines += it.second.line_count();
+        }
+        size_t l1i_bytes = 0, l1i_allocated = 0, l1i_lines = 0;
+        for (const auto& it : fetch_units) {
+            l1i_bytes += it.second.cache.host_memory_bytes();
+            l1i_allocated += it.second.cache.allocated_line_count();
+            l1i_lines += it.second.cache.line_count();
+        }
+        const struct {
+            const char* name;
+            size_t caches, bytes, allocated, lines;
+        } levels[] = {
+            {"l1", l1_caches.size(), l1_bytes, l1_allocated, l1_lines},
+            {"l1i", fetch_units.size(), l1i_bytes, l1i_allocated, l1i_lines},
+            {"l2", 1, l2_cache.host_memory_bytes(), l2_cache.allocated_line_count(), l2_cache.line_count()},
+            {"l3", 1, l3_cache.host_memory_bytes(), l3_cache.allocated_line_count(), l3_cache.line_count()},
+        };
+        json.begin_object("host_memory");
+        size_t total = 0;
+        for (const auto& level : levels) {
+            json.begin_object(level.name);
+            json.value("caches", level.caches);
+            json.value("bytes", level.bytes);
+            json.value("allocated_lines", level.allocated);
+            json.value("allocated_fraction", level.lines ? static_cast<double>(level.allocated) / level.lines : 0.0);
+            json.end_object();
+            total += level.bytes;
+        }
+        json.value("total_bytes", total);
+        if (arena) {
+            json.begin_object("arena");
+            json.value("huge_pages", std::string(huge_pages_name(arena->huge_page_mode())));
+            json.value("regions", arena->region_count());
+            json.value("reserved_bytes", arena->reserved_bytes());
+            json.value("used_bytes", arena->used_bytes());
+            json.end_object();
+        }
+        json.end_object();
+    }
+
+    void write_icache_json(JsonWriter& json) const {
+        size_t fetches = 0, misses = 0, prefetches = 0, useful = 0;
+        for (const auto& it : fetch_units) {
+            fetches += it.second.fetches;
+            misses += it.second.misses;
+            prefetches += it.second.prefetches;
+            useful += it.second.useful_prefetches;
+        }
+        json.begin_object("icache");
+        json.value("size", l1i_size);
+        json.value("unified", icache_unified);
+        json.value("next_line_prefetch", icache_prefetch);
+        json.value("fetches", fetches);
+        json.value("misses", misses);
+        json.value("miss_rate", fetches ? static_cast<double>(misses) / fetches : 0.0);
+        json.value("prefetches", prefetches);
+        json.value("useful_prefetches", useful);
+        json.value("code_lines", code_lines.size());
+        if (icache_unified) {
+            // Доля линий общих уровней, занятых кодом, на конец прогона
+            auto is_code = [this](uint64_t address) { return code_lines.count(address / l1i_line_size * l1i_line_size) > 0; };
+            size_t l2_lines = 0, l2_code = 0, l3_lines = 0, l3_code = 0;
+            l2_cache.count_lines(is_code, l2_lines, l2_code);
+            l3_cache.count_lines(is_code, l3_lines, l3_code);
+            json.value("l2_code_fraction", l2_lines ? static_cast<double>(l2_code) / l2_lines : 0.0);
+            json.value("l3_code_fraction", l3_lines ? static_cast<double>(l3_code) / l3_lines : 0.0);
+        }
+        json.end_object();
+    }
+
+    void write_tlb_json(JsonWriter& json) const {
+        size_t l1_hits = 0, l1_misses = 0;
+        for (const auto& it : l1_tlbs) {
+            l1_hits += it.second.hit_count();
+            l1_misses += it.second.miss_count();
+        }
+        const size_t l2_accesses = l2_tlb.hit_count() + l2_tlb.miss_count();
+        json.begin_object("tlb");
+        json.value("page_size_ranges", page_sizes.range_count());
+        json.value("l1_entries", tlb_options.l1_entries);
+        json.value("l1_hits", l1_hits);
+        json.value("l1_misses", l1_misses);
+        json.value("l1_miss_rate", l1_hits + l1_misses ? static_cast<double>(l1_misses) / (l1_hits + l1_misses) : 0.0);
+        json.value("l2_entries", tlb_options.l2_entries);
+        json.value("l2_hits", l2_tlb.hit_count());
+        json.value("l2_misses", l2_tlb.miss_count());
+        json.value("l2_miss_rate", l2_accesses ? static_cast<double>(l2_tlb.miss_count()) / l2_accesses : 0.0);
+        json.value("page_walks", l2_tlb.miss_count());
+        json.value("walks_4k", walks_by_page_size[0]);
+        json.value("walks_2m", walks_by_page_size[1]);
+        json.value("walks_1g", walks_by_page_size[2]);
+        if (walker_enabled) {
+            const KindStats& walks = kind_stats[static_cast<size_t>(AccessKind::PageWalk)];
+            size_t l2_lines = 0, l2_table_lines = 0, l3_lines = 0, l3_table_lines = 0;
+            auto is_table = [](uint64_t address) {
+                return address >= PageWalker::TABLE_REGION && address < PageWalker::TABLE_REGION_END;
+            };
+            l2_cache.count_lines(is_table, l2_lines, l2_table_lines);
+            l3_cache.count_lines(is_table, l3_lines, l3_table_lines);
+            json.begin_object("page_walker");
+            walker.write_json(json);
+            json.value("pte_l1_hits", walks.hits[0]);
+            json.value("pte_l2_hits", walks.hits[1]);
+            json.value("pte_l3_hits", walks.hits[2]);
+            json.value("pte_memory_reads", walks.hits[3]);
+            // Доля занятых линий, которые держат таблицы страниц, на конец прогона
+            json.value("l2_table_lines", l2_table_lines);
+            json.value("l2_table_fraction", l2_lines ? static_cast<double>(l2_table_lines) / l2_lines : 0.0);
+            json.value("l3_table_lines", l3_table_lines);
+            json.value("l3_table_fraction", l3_lines ? static_cast<double>(l3_table_lines) / l3_lines : 0.0);
+            json.end_object();
+        }
+        json.end_object();
+    }
+
+    CacheStats l1_statistics() const {
+        CacheStats total;
+        for (const auto& l1 : l1_caches) {
+            total.merge(l1.second.statistics());
+        }
+        return total;
+    }
+
+    const CacheStats& l2_statistics() const { return l2_cache.statistics(); }
+    CacheStats l3_statistics() const { return l3_cache.statistics(); }
+
+    void write_json(JsonWriter& json) const {
+        json.begin_object("levels");
+        write_level_json(json, "l1", l1_statistics());
+        write_level_json(json, "l2", l2_cache.statistics(), &l2_cache);
+        l3_cache.write_json(json, "l3");
+        json.end_object();
+
+        json.begin_array("threads");
+        for (const auto& it : thread_stats) {
+            const ThreadStats& thread = it.second;
+            json.begin_object();
+            json.value("thread_id", it.first);
+            json.value("core", thread.core);
+            json.value("accesses", thread.accesses);
+            json.value("l1_hits", thread.l1_hits);
+            json.value("l1_misses", thread.l1_misses);
+            json.value("l2_hits", thread.l2_hits);
+            json.value("l2_misses", thread.l2_misses);
+            json.value("l3_hits", thread.l3_hits);
+            json.value("l3_misses", thread.l3_misses);
+            json.value("latency_cycles", thread.latency_cycles);
+            json.value("stall_cycles", thread.stall_cycles);
+            json.value("amat", thread.amat());
+            if (mlp.enabled) {
+                json.value("cycles", thread.total_cycles());
+                json.value("mlp", thread.mlp());
+            }
+            if (icache_enabled) {
+                json.value("ifetches", thread.ifetches);
+                json.value("l1i_misses", thread.l1i_misses);
+                json.value("ifetch_stall_cycles", thread.ifetch_stall_cycles);
+            }
+            if (tlb_enabled) {
+                json.value("dtlb_misses", thread.dtlb_misses);
+                json.value("dtlb_miss_rate", thread.accesses ? static_cast<double>(thread.dtlb_misses) / thread.accesses : 0.0);
+                json.value("page_walks", thread.page_walks);
+                json.value("translation_cycles", thread.translation_cycles);
+            }
+            json.end_object();
+        }
+        json.end_array();
+
+        json.begin_array("access_kinds");
+        for (size_t kind = 0; kind < static_cast<size_t>(AccessKind::Count); ++kind) {
+            const KindStats& stats = kind_stats[kind];
+            if (stats.accesses == 0) {
+                continue;
+            }
+            json.begin_object();
+            json.value("kind", std::string(access_kind_name(static_cast<AccessKind>(kind))));
+            json.value("accesses", stats.accesses);
+            json.value("l1_hits", stats.hits[0]);
+            json.value("l2_hits", stats.hits[1]);
+            json.value("l3_hits", stats.hits[2]);
+            json.value("memory", stats.hits[3]);
+            json.value("writebacks", stats.writebacks);
+            json.end_object();
+        }
+        json.end_array();
+
+        if (tlb_enabled) {
+            write_tlb_json(json);
+        }
+        if (icache_enabled) {
+            write_icache_json(json);
+        }
+        write_host_memory_json(json);
+        if (coherence_enabled) {
+            json.begin_object("coherence");
+            json.value("invalidations", coherence_invalidations);
+            json.value("transfers", coherence_transfers);
+            json.end_object();
+        }
+        if (physical_enabled) {
+            json.begin_object("physical_memory");
+            physical.write_json(json);
+            json.value("l1_indexing", std::string(l1_vipt ? "vipt" : "pipt"));
+            json.end_object();
+        }
+
+        uint64_t accesses, latency_cycles, stall_cycles;
+        total_latency(accesses, latency_cycles, stall_cycles);
+        json.begin_object("latency");
+        json.value("l1_latency", latency.l1);
+        json.value("l2_latency", latency.l2);
+        json.value("l3_latency", latency.l3);
+        json.value("memory_latency", latency.memory);
+        json.value("latency_cycles", latency_cycles);
+        json.value("stall_cycles", stall_cycles);
+        json.value("amat", amat());
+        json.histogram("histogram", latency_histogram);
+        if (mlp.enabled) {
+            MshrFile l1_mshr_total(mlp.l1_mshrs);
+            uint64_t miss_cycles = 0, miss_busy_cycles = 0;
+            for (const auto& it : thread_stats) {
+                l1_mshr_total.merge_statistics(it.second.l1_mshr);
+                miss_cycles += it.second.miss_cycles;
+                miss_busy_cycles += it.second.miss_busy_cycles;
+            }
+            json.begin_object("mlp");
+            json.value("issue_window", mlp.issue_window);
+            json.value("issue_cycles", mlp.issue_cycles);
+            json.value("mlp", miss_busy_cycles ? static_cast<double>(miss_cycles) / miss_busy_cycles : 0.0);
+            l1_mshr_total.write_json(json, "l1_mshr");
+            l2_mshr.write_json(json, "l2_mshr");
+            l3_mshr.write_json(json, "l3_mshr");
+            json.end_object();
+        }
+        if (track_pc_stalls) {
+            // PC с наибольшими потерями
+            std::vector<std::pair<uint64_t, PcStats> > pcs(pc_stats.begin(), pc_stats.end());
+            const size_t top = std::min<size_t>(pcs.size(), 32);
+            std::partial_sort(pcs.begin(), pcs.begin() + top, pcs.end(),
+                              [](const std::pair<uint64_t, PcStats>& a, const std::pair<uint64_t, PcStats>& b) {
+                                  return a.second.stall_cycles > b.second.stall_cycles;
+                              });
+            json.value("distinct_pcs", pcs.size());
+            json.begin_array("top_stall_pcs");
+            for (size_t i = 0; i < top; ++i) {
+                json.begin_object();
+                json.value("pc", pcs[i].first);
+                json.value("accesses", pcs[i].second.accesses);
+                json.value("stall_cycles", pcs[i].second.stall_cycles);
+                json.end_object();
+            }
+            json.end_array();
+        }
+        json.end_object();
+
+        json.begin_object("memory");
+        json.value("reads", memory_reads);
+        json.value("writebacks", memory_writebacks);
+        if (dram_enabled) {
+            dram.write_json(json);
+        }
+        if (tiers_enabled) {
+            tiered.write_json(json);
+        }
+        if (memory_cache_enabled) {
+            memory_cache.write_json(json);
+        }
+        json.end_object();
+
+        json.value("reuse_distance_enabled", track_reuse_distance);
+        json.histogram("reuse_distance", reuse_distance);
+    }
+
+private:
+    static void write_level_json(JsonWriter& json, const std::string& name, const CacheStats& stats,
+                                 const Cache* cache = nullptr) {
+        json.begin_object(name);
+        write_cache_fields(json, stats, cache);
+        json.end_object();
+    }
+};
+
+
+// Параметры моделирования. Все поля перечислены в visit(): по этому списку
+// разбираются аргументы командной строки и печатается конфигурация в результатах
+struct SimulationConfig {
+    // Можно промедилировать полностью ассоциативный кеш, подобрав нужную ассоциативность
+    size_t num_cores = 78;                      // количество ядер
+    size_t l1_size = 5 * 1024 * 1024;           // L1 size (5 MiB)
+    size_t l1_line_size = 64;                   // L1 line size
+    size_t l1_associativity = 8;                // L1 associativity
+    size_t l2_size = 39 * 1024 * 1024;          // L2 size (39 MiB)
+    size_t l2_line_size = 64;                   // L2 line size
+    size_t l2_associativity = 8;                // L2 associativity
+    size_t l3_size = 6 * 1024 * 1024;           // L3 size (64 MiB)
+    size_t l3_line_size = 64;                   // L3 line size
+    size_t l3_associativity = 16;               // L3 associativity
+
+    std::string trace = "memory_trace.log";
+    std::string trace_format = "auto";          // auto, text, binary, lackey, drcachesim или champsim
+    std::string convert_output;                 // перекодировать трассу в двоичный формат и выйти
+    bool self_test = false;                     // проверить модель на встроенных сценариях и выйти
+    double timestamp_scale = 1.0;               // тактов на единицу времени записи, 0 - не учитывать время
+    std::string trace_merge = "timestamp";      // порядок слияния файлов: timestamp, sequence (round_robin), instructions
+    bool trace_file_threads = false;            // номер потока записи - номер файла трассы
+    std::string filter_threads;                 // моделировать только эти потоки (через запятую)
+    std::string filter_kinds;                   // только эти виды обращений: load,store,...
+    std::string filter_address;                 // только адреса из диапазона начало-конец
+    std::string filter_pc;                      // только PC из диапазона начало-конец
+    std::string filter_records;                 // только записи с номерами из диапазона N-M
+    std::string mix;                            // трассы нагрузок через запятую для совместного запуска
+    std::string mix_order = "round_robin";      // порядок смешивания: round_robin (sequence), instructions, timestamp
+    size_t interleavings = 0;                   // затравок чередования потоков на квант, 0 - без анализа
+    std::string interleave_quanta = "1,64,4096"; // записей потока подряд, через запятую
+    size_t interleave_jobs = 0;                 // параллельных прогонов, 0 - по числу аппаратных потоков
+    bool reuse_distance = false;                // собирать гистограмму дистанций повторного использования
+    bool coherence = false;                     // согласованность частных L1 (запись с аннулированием)
+    bool l0_filter = true;                      // быстрый путь L1 для повтора последней линии потока
+    std::string huge_pages = "transparent";     // страницы арены с линиями кешей: none, transparent, explicit
+    std::string json_output;                    // файл для результатов в JSON
+    std::string csv_output;                     // файл, в который дописывается строка CSV (для свипов)
+
+    // Политики допуска: none, probabilistic, bip, sdbp, perceptron
+    std::string l1_admission = "none";
+    std::string l2_admission = "none";
+    std::string l3_admission = "none";
+    double admission_probability = 0.5;         // вероятность размещения для probabilistic
+    double bip_epsilon = 1.0 / 32;              // доля вставок в MRU для bip
+    bool admission_compare = false;             // дополнительно прогнать трассу с обычным LRU для сравнения
+
+    // Разделение путей общих уровней: none, static, ucp.
+    // Поток с порядковым номером c относится к группе c % partition_groups
+    std::string l2_partition = "none";
+    std::string l3_partition = "none";
+    size_t partition_groups = 2;
+    std::string partition_masks;                // маски путей групп через запятую, например 0xff00,0x00ff
+    size_t partition_epoch = 100000;            // длина эпохи UCP и интервал снимков занятости
+
+    // Функции индекса сета: modulo, xor, prime, skewed
+    std::string l1_index = "modulo";
+    std::string l2_index = "modulo";
+    std::string l3_index = "modulo";
+    bool set_heatmap = false;                   // считать обращения и промахи по сетам
+    std::string heatmap_output;                 // CSV с полной картой сетов (level,set,accesses,misses)
+    bool benchmark_index = false;               // замерить скорость моделирования для каждой функции индекса
+
+    // NUCA: L3 из l3_slices слайсов, выбор слайса modulo, xor или intel,
+    // межсоединение ring или mesh
+    size_t l3_slices = 1;
+    std::string slice_hash = "modulo";
+    std::string interconnect = "ring";
+    size_t hop_latency = 1;                     // тактов на переход
+    size_t mesh_columns = 0;                    // ширина сетки, 0 - примерно квадратная
+
+    // Задержки в тактах
+    size_t l1_latency = 4;
+    size_t l2_latency = 14;
+    size_t l3_latency = 40;
+    size_t memory_latency = 200;
+    bool pc_stalls = false;                     // накапливать такты простоя по PC
+
+    // Модель параллелизма памяти: окно незавершенных промахов потока и MSHR уровней
+    bool mlp_model = false;
+    size_t issue_window = 16;
+    size_t issue_cycles = 1;
+    size_t l1_mshrs = 16;
+    size_t l2_mshrs = 32;
+    size_t l3_mshrs = 64;
+
+    // Модель DRAM вместо фиксированной memory_latency (тайминги в тактах процессора)
+    bool dram_model = false;
+    size_t dram_channels = 1;
+    size_t dram_ranks = 1;
+    size_t dram_banks = 8;
+    size_t dram_row_size = 8192;
+    std::string dram_page_policy = "open";      // open или closed
+    std::string dram_mapping = "row_rank_bank_col_chan";  // или row_col_rank_bank_chan, xor_bank
+    size_t dram_trcd = 42;
+    size_t dram_tcas = 42;
+    size_t dram_trp = 42;
+    size_t dram_tburst = 8;
+    size_t dram_base_latency = 60;
+
+    // Многоуровневая память: узлы NUMA и дальняя память CXL (емкости в байтах, 0 - без ограничения)
+    bool tiered_memory = false;
+    size_t numa_nodes = 1;
+    size_t numa_node_capacity = 0;
+    double numa_bandwidth = 32.0;               // байт за такт на узел
+    size_t numa_remote_latency = 60;
+    size_t cxl_capacity = 0;                    // 0 - без уровня CXL
+    double cxl_bandwidth = 8.0;
+    size_t cxl_latency = 170;
+    size_t tier_page_size = 4096;
+    std::string page_placement = "first_touch"; // first_touch или interleave
+    bool page_migration = false;
+    size_t migration_threshold = 32;
+    size_t migration_epoch = 10000;
+    size_t migration_cost = 2000;
+
+    // Кеш на стороне памяти между L3 и памятью
+    bool memory_side_cache = false;
+    std::string msc_design = "alloy";           // alloy или page
+    size_t msc_size = 256 * 1024 * 1024;
+    size_t msc_block_size = 0;                  // 0 - по организации
+    size_t msc_associativity = 0;               // 0 - по организации
+    size_t msc_hit_latency = 80;
+    size_t msc_probe_latency = 40;
+
+    // TLB: L1 DTLB на ядро и общий L2 TLB
+    bool tlb = false;
+    size_t dtlb_entries = 64;
+    size_t dtlb_associativity = 4;
+    size_t stlb_entries = 1536;
+    size_t stlb_associativity = 12;
+    std::string tlb_replacement = "lru";        // lru или random
+    size_t stlb_latency = 7;
+    size_t page_walk_latency = 30;
+    std::string page_size = "4k";               // 4k, 2m или 1g
+    std::string page_size_map;                  // файл "начало конец размер" с размерами страниц
+    bool page_walker = false;                   // обходить таблицы через кеши вместо page_walk_latency
+    size_t page_table_levels = 4;               // 4 или 5
+    size_t pwc_entries = 32;                    // элементов в кеше обхода каждого уровня, 0 - без PWC
+
+    // Физические адреса для L2, L3 и памяти: none - адреса трассы без трансляции,
+    // sequential, random, coloring или huge_contiguous
+    std::string frame_allocator = "none";
+    size_t physical_memory = 16ULL << 30;
+    size_t page_colors = 0;                     // 0 - по геометрии L3
+    std::string l1_indexing = "vipt";           // vipt или pipt
+
+    // L1-I по PC из return_address
+    bool icache = false;
+    size_t l1i_size = 32 * 1024;
+    size_t l1i_line_size = 64;
+    size_t l1i_associativity = 8;
+    bool icache_unified = true;                 // промахи L1-I конкурируют с данными в L2/L3
+    bool icache_prefetch = true;                // предвыборка следующей линии
+    size_t seed = 1;
+
+    template <typename Visitor>
+    void visit(Visitor&& visitor) { visit_fields(*this, visitor); }
+
+    template <typename Visitor>
+    void visit(Visitor&& visitor) const { visit_fields(*this, visitor); }
+
+private:
+    template <typename Self, typename Visitor>
+    static void visit_fields(Self& self, Visitor& visitor) {
+        visitor("num_cores", self.num_cores);
+        visitor("l1_size", self.l1_size);
+        visitor("l1_line_size", self.l1_line_size);
+        visitor("l1_associativity", self.l1_associativity);
+        visitor("l2_size", self.l2_size);
+        visitor("l2_line_size", self.l2_line_size);
+        visitor("l2_associativity", self.l2_associativity);
+        visitor("l3_size", self.l3_size);
+        visitor("l3_line_size", self.l3_line_size);
+        visitor("l3_associativity", self.l3_associativity);
+        visitor("trace", self.trace);
+        visitor("trace_format", self.trace_format);
+        visitor("convert_output", self.convert_output);
+        visitor("self_test", self.self_test);
+        visitor("timestamp_scale", self.timestamp_scale);
+        visitor("trace_merge", self.trace_merge);
+        visitor("trace_file_threads", self.trace_file_threads);
+        visitor("filter_threads", self.filter_threads);
+        visitor("filter_kinds", self.filter_kinds);
+        visitor("filter_address", self.filter_address);
+        visitor("filter_pc", self.filter_pc);
+        visitor("filter_records", self.filter_records);
+        visitor("mix", self.mix);
+        visitor("mix_order", self.mix_order);
+        visitor("interleavings", self.interleavings);
+        visitor("interleave_quanta", self.interleave_quanta);
+        visitor("interleave_jobs", self.interleave_jobs);
+        visitor("reuse_distance", self.reuse_distance);
+        visitor("coherence", self.coherence);
+        visitor("l0_filter", self.l0_filter);
+        visitor("huge_pages", self.huge_pages);
+        visitor("json_output", self.json_output);
+        visitor("csv_output", self.csv_output);
+        visitor("l1_admission", self.l1_admission);
+        visitor("l2_admission", self.l2_admission);
+        visitor("l3_admission", self.l3_admission);
+        visitor("admission_probability", self.admission_probability);
+        visitor("bip_epsilon", self.bip_epsilon);
+        visitor("admission_compare", self.admission_compare);
+        visitor("l2_partition", self.l2_partition);
+        visitor("l3_partition", self.l3_partition);
+        visitor("partition_groups", self.partition_groups);
+        visitor("partition_masks", self.partition_masks);
+        visitor("partition_epoch", self.partition_epoch);
+        visitor("l1_index", self.l1_index);
+        visitor("l2_index", self.l2_index);
+        visitor("l3_index", self.l3_index);
+        visitor("set_heatmap", self.set_heatmap);
+        visitor("heatmap_output", self.heatmap_output);
+        visitor("benchmark_index", self.benchmark_index);
+        visitor("l3_slices", self.l3_slices);
+        visitor("slice_hash", self.slice_hash);
+        visitor("interconnect", self.interconnect);
+        visitor("hop_latency", self.hop_latency);
+        visitor("mesh_columns", self.mesh_columns);
+        visitor("l1_latency", self.l1_latency);
+        visitor("l2_latency", self.l2_latency);
+        visitor("l3_latency", self.l3_latency);
+        visitor("memory_latency", self.memory_latency);
+        visitor("pc_stalls", self.pc_stalls);
+        visitor("mlp_model", self.mlp_model);
+        visitor("issue_window", self.issue_window);
+        visitor("issue_cycles", self.issue_cycles);
+        visitor("l1_mshrs", self.l1_mshrs);
+        visitor("l2_mshrs", self.l2_mshrs);
+        visitor("l3_mshrs", self.l3_mshrs);
+        visitor("dram_model", self.dram_model);
+        visitor("dram_channels", self.dram_channels);
+        visitor("dram_ranks", self.dram_ranks);
+        visitor("dram_banks", self.dram_banks);
+        visitor("dram_row_size", self.dram_row_size);
+        visitor("dram_page_policy", self.dram_page_policy);
+        visitor("dram_mapping", self.dram_mapping);
+        visitor("dram_trcd", self.dram_trcd);
+        visitor("dram_tcas", self.dram_tcas);
+        visitor("dram_trp", self.dram_trp);
+        visitor("dram_tburst", self.dram_tburst);
+        visitor("dram_base_latency", self.dram_base_latency);
+        visitor("tiered_memory", self.tiered_memory);
+        visitor("numa_nodes", self.numa_nodes);
+        visitor("numa_node_capacity", self.numa_node_capacity);
+        visitor("numa_bandwidth", self.numa_bandwidth);
+        visitor("numa_remote_latency", self.numa_remote_latency);
+        visitor("cxl_capacity", self.cxl_capacity);
+        visitor("cxl_bandwidth", self.cxl_bandwidth);
+        visitor("cxl_latency", self.cxl_latency);
+        visitor("tier_page_size", self.tier_page_size);
+        visitor("page_placement", self.page_placement);
+        visitor("page_migration", self.page_migration);
+        visitor("migration_threshold", self.migration_threshold);
+        visitor("migration_epoch", self.migration_epoch);
+        visitor("migration_cost", self.migration_cost);
+        visitor("memory_side_cache", self.memory_side_cache);
+        visitor("msc_design", self.msc_design);
+        visitor("msc_size", self.msc_size);
+        visitor("msc_block_size", self.msc_block_size);
+        visitor("msc_associativity", self.msc_associativity);
+        visitor("msc_hit_latency", self.msc_hit_latency);
+        visitor("msc_probe_latency", self.msc_probe_latency);
+        visitor("tlb", self.tlb);
+        visitor("dtlb_entries", self.dtlb_entries);
+        visitor("dtlb_associativity", self.dtlb_associativity);
+        visitor("stlb_entries", self.stlb_entries);
+        visitor("stlb_associativity", self.stlb_associativity);
+        visitor("tlb_replacement", self.tlb_replacement);
+        visitor("stlb_latency", self.stlb_latency);
+        visitor("page_walk_latency", self.page_walk_latency);
+        visitor("page_size", self.page_size);
+        visitor("page_size_map", self.page_size_map);
+        visitor("page_walker", self.page_walker);
+        visitor("page_table_levels", self.page_table_levels);
+        visitor("pwc_entries", self.pwc_entries);
+        visitor("frame_allocator", self.frame_allocator);
+        visitor("physical_memory", self.physical_memory);
+        visitor("page_colors", self.page_colors);
+        visitor("l1_indexing", self.l1_indexing);
+        visitor("icache", self.icache);
+        visitor("l1i_size", self.l1i_size);
+        visitor("l1i_line_size", self.l1i_line_size);
+        visitor("l1i_associativity", self.l1i_associativity);
+        visitor("icache_unified", self.icache_unified);
+        visitor("icache_prefetch", self.icache_prefetch);
+        visitor("seed", self.seed);
+    }
+};
+
+
+// Размеры можно задавать с суффиксами K, M, G (степени 1024)
+bool parse_value(const std::string& text, size_t& out) {
+    char* end = nullptr;
+    unsigned long long number = std::strtoull(text.c_str(), &end, 0);
+    if (end == text.c_str()) {
+        return false;
+    }
+    std::string suffix(end);
+    if (suffix == "K" || suffix == "k") {
+        number *= 1024ULL;
+    } else if (suffix == "M" || suffix == "m") {
+        number *= 1024ULL * 1024;
+    } else if (suffix == "G" || suffix == "g") {
+        number *= 1024ULL * 1024 * 1024;
+    } else if (!suffix.empty()) {
+        return false;
+    }
+    out = number;
+    return true;
+}
+
+bool parse_value(const std::string& text, bool& out) {
+    if (text == "1" || text == "true" || text == "yes" || text == "on") {
+        out = true;
+    } else if (text == "0" || text == "false" || text == "no" || text == "off") {
+        out = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parse_value(const std::string& text, double& out) {
+    char* end = nullptr;
+    out = std::strtod(text.c_str(), &end);
+    return end != text.c_str() && *end == '\0';
+}
+
+bool parse_value(const std::string& text, std::string& out) {
+    out = text;
+    return true;
+}
+
+std::string to_text(size_t value) { return std::to_string(value); }
+std::string to_text(bool value) { return value ? "1" : "0"; }
+std::string to_text(const std::string& value) { return value; }
+
+std::string to_text(double value) {
+    std::ostringstream out;
+    out << std::setprecision(10) << value;
+    return out.str();
+}
+
+
+// Аргументы вида --name=value, где name - поле SimulationConfig
+bool parse_arguments(int argc, char** argv, SimulationConfig& config) {
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--help" || argument == "-h") {
+            std::cout << "Usage: " << argv[0] << " [--option=value ...]\nOptions (default values):\n";
+            config.visit([](const std::string& name, const auto& field) {
+                std::cout << "  --" << name << "=" << to_text(field) << "\n";
+            });
+            return false;
+        }
+
+        size_t eq = argument.find('=');
+        if (argument.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+            std::cerr << "Invalid argument: " << argument << " (expected --option=value)\n";
+            return false;
+        }
+        std::string name = argument.substr(2, eq - 2);
+        std::string text = argument.substr(eq + 1);
+
+        bool found = false;
+        bool parsed = false;
+        config.visit([&](const std::string& field_name, auto& field) {
+            if (field_name == name) {
+                found = true;
+                parsed = parse_value(text, field);
+            }
+        });
+        if (!found) {
+            std::cerr << "Unknown option: --" << name << "\n";
+            return false;
+        }
+        if (!parsed) {
+            std::cerr << "Invalid value for --" << name << ": " << text << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Строка текстовой трассы: "<тип><размер> адрес поток pc [время]", например "s8 4096 1 4198400".
+// Возвращает false для пустых и нераспознанных строк
+bool parse_log_line(const std::string& line, LogEntry& entry) {
+    std::istringstream ss(line);
+    std::string access_type;
+    if (!(ss >> access_type >> entry.address >> entry.thread_id >> entry.return_address)) {
+        return false;
+    }
+    entry.kind = access_kind_from_letter(access_type[0]);
+    entry.size = static_cast<uint32_t>(std::strtoul(access_type.c_str() + 1, nullptr, 10));
+    if (!(ss >> entry.timestamp)) {
+        entry.timestamp = 0;
+    }
+    return true;
+}
+
+
+// Собственный двоичный формат трассы: заголовок и записи фиксированного размера
+// в порядке байт машины. Читается в разы быстрее текста
+const char BINARY_TRACE_MAGIC[8] = {'M', 'E', 'M', 'T', 'R', 'A', 'C', 'E'};
+const uint32_t BINARY_TRACE_VERSION = 1;
+
+struct BinaryTraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+};
+
+struct BinaryTraceRecord {
+    uint64_t address;
+    uint64_t return_address;
+    uint64_t thread_id;
+    uint64_t timestamp;
+    uint8_t kind;
+    uint8_t reserved[3];
+    uint32_t size;
+};
+static_assert(sizeof(BinaryTraceRecord) == 40, "binary trace record must be packed");
+
+
+// Источник записей трассы
+class TraceReader {
+public:
+    virtual ~TraceReader() {}
+    // false - конец трассы
+    virtual bool next(LogEntry& entry) = 0;
+};
+
+class TextTraceReader : public TraceReader {
+private:
+    std::ifstream input;
+    std::string line;
+
+public:
+    explicit TextTraceReader(const std::string& path) : input(path) {}
+
+    bool is_open() const { return static_cast<bool>(input); }
+
+    bool next(LogEntry& entry) override {
+        while (std::getline(input, line)) {
+            if (parse_log_line(line, entry)) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+class BinaryTraceReader : public TraceReader {
+private:
+    std::ifstream input;
+    std::vector<BinaryTraceRecord> buffer;
+    size_t position;
+    size_t count;
+
+public:
+    explicit BinaryTraceReader(const std::string& path)
+        : input(path, std::ios::binary), buffer(4096), position(0), count(0) {
+        BinaryTraceHeader header;
+        if (!input.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            std::string(header.magic, 8) != std::string(BINARY_TRACE_MAGIC, 8) ||
+            header.version != BINARY_TRACE_VERSION || header.record_size != sizeof(BinaryTraceRecord)) {
+            input.setstate(std::ios::failbit);
+        }
+    }
+
+    bool is_open() const { return static_cast<bool>(input); }
+
+    bool next(LogEntry& entry) override {
+        if (position == count) {
+            input.read(reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(BinaryTraceRecord));
+            count = static_cast<size_t>(input.gcount()) / sizeof(BinaryTraceRecord);
+            position = 0;
+            if (count == 0) {
+                return false;
+            }
+        }
+        const BinaryTraceRecord& record = buffer[position++];
+        entry.kind = record.kind < static_cast<uint8_t>(AccessKind::Count) ? static_cast<AccessKind>(record.kind)
+                                                                            : AccessKind::Load;
+        entry.size = record.size;
+        entry.address = record.address;
+        entry.thread_id = record.thread_id;
+        entry.return_address = record.return_address;
+        entry.timestamp = record.timestamp;
+        return true;
+    }
+};
+
+// Вывод Valgrind lackey (--trace-mem=yes): "I  04010173,3", " L 04222cac,8",
+// " S ...", " M ..." (M - чтение и запись одной инструкцией). PC берется из
+// последней строки I, время - счетчик инструкций, номера потока нет
+class LackeyTraceReader : public TraceReader {
+private:
+    std::ifstream input;
+    std::string line;
+    uint64_t pc;
+    uint64_t instructions;
+    bool has_pending;
+    LogEntry pending;
+
+public:
+    explicit LackeyTraceReader(const std::string& path)
+        : input(path), pc(0), instructions(0), has_pending(false) {}
+
+    bool is_open() const { return static_cast<bool>(input); }
+
+    bool next(LogEntry& entry) override {
+        if (has_pending) {
+            has_pending = false;
+            entry = pending;
+            return true;
+        }
+        while (std::getline(input, line)) {
+            const size_t type_pos = line.find_first_not_of(' ');
+            if (type_pos == std::string::npos || line[type_pos] == '=') {
+                continue;
+            }
+            char* end = nullptr;
+            const uint64_t address = std::strtoull(line.c_str() + type_pos + 1, &end, 16);
+            const uint32_t size = *end == ',' ? static_cast<uint32_t>(std::strtoul(end + 1, nullptr, 10)) : 0;
+            const char type = line[type_pos];
+            if (type == 'I') {
+                pc = address;
+                instructions++;
+                continue;
+            }
+            if (type != 'L' && type != 'S' && type != 'M') {
+                continue;
+            }
+            entry = LogEntry();
+            entry.kind = type == 'S' ? AccessKind::Store : AccessKind::Load;
+            entry.size = size;
+            entry.address = address;
+            entry.return_address = pc;
+            entry.timestamp = instructions;
+            if (type == 'M') {
+                pending = entry;
+                pending.kind = AccessKind::Store;
+                has_pending = true;
+            }
+            return true;
+        }
+        return false;
+    }
+};
+
+// Трасса DynamoRIO drcachesim после raw2trace (без сжатия): записи trace_entry_t
+// по 12 байт - тип (2), размер (2), адрес (8). Записи THREAD переключают поток,
+// записи инструкций задают PC, время - счетчик инструкций потока. Запись
+// INSTR_BUNDLE - size инструкций подряд за предыдущей, на месте адреса их длины
+class DrcachesimTraceReader : public TraceReader {
+private:
+    enum : uint16_t {
+        TYPE_READ = 0,
+        TYPE_WRITE = 1,
+        TYPE_PREFETCH_FIRST = 2,
+        TYPE_PREFETCH_LAST = 8,
+        TYPE_INSTR_FIRST = 10,
+        TYPE_INSTR_LAST = 16,
+        TYPE_INSTR_BUNDLE = 17,
+        TYPE_DATA_FLUSH = 20,
+        TYPE_THREAD = 22,
+        TYPE_INSTR_NO_FETCH = 29,
+        TYPE_INSTR_MAYBE_FETCH = 30
+    };
+    static const size_t ENTRY_SIZE = 12;
+
+    struct ThreadState {
+        uint64_t pc;
+        uint64_t instructions;
+        uint16_t length;  // длина инструкции по адресу pc
+    };
+
+    std::ifstream input;
+    std::vector<char> buffer;
+    size_t position;
+    size_t count;
+    uint64_t thread_id;
+    std::unordered_map<uint64_t, ThreadState> threads;
+
+public:
+    explicit DrcachesimTraceReader(const std::string& path)
+        : input(path, std::ios::binary), buffer(ENTRY_SIZE * 4096), position(0), count(0), thread_id(0) {}
+
+    bool is_open() const { return static_cast<bool>(input); }
+
+    bool next(LogEntry& entry) override {
+        for (;;) {
+            if (position == count) {
+                input.read(buffer.data(), buffer.size());
+                count = static_cast<size_t>(input.gcount()) / ENTRY_SIZE;
+                position = 0;
+                if (count == 0) {
+                    return false;
+                }
+            }
+            const char* raw = buffer.data() + ENTRY_SIZE * position++;
+            uint16_t type, size;
+            uint64_t address;
+            std::copy(raw, raw + 2, reinterpret_cast<char*>(&type));
+            std::copy(raw + 2, raw + 4, reinterpret_cast<char*>(&size));
+            std::copy(raw + 4, raw + 12, reinterpret_cast<char*>(&address));
+
+            ThreadState& state = threads[thread_id];
+            if (type == TYPE_THREAD) {
+                thread_id = address;
+            } else if ((type >= TYPE_INSTR_FIRST && type <= TYPE_INSTR_LAST) || type == TYPE_INSTR_NO_FETCH ||
+                       type == TYPE_INSTR_MAYBE_FETCH) {
+                state.pc = address;
+                state.length = size;
+                state.instructions++;
+            } else if (type == TYPE_INSTR_BUNDLE) {
+                for (uint16_t i = 0; i < size && i < sizeof(address); ++i) {
+                    state.pc += state.length;
+                    state.length = static_cast<unsigned char>(raw[4 + i]);
+                }
+                state.instructions += size;
+            } else if (type == TYPE_READ || type == TYPE_WRITE || type == TYPE_DATA_FLUSH ||
+                       (type >= TYPE_PREFETCH_FIRST && type <= TYPE_PREFETCH_LAST)) {
+                entry = LogEntry();
+                entry.kind = type == TYPE_READ ? AccessKind::Load
+                           : type == TYPE_WRITE ? AccessKind::Store
+                           : type == TYPE_DATA_FLUSH ? AccessKind::Flush : AccessKind::Prefetch;
+                entry.size = size;
+                entry.address = address;
+                entry.thread_id = thread_id;
+                entry.return_address = state.pc;
+                entry.timestamp = state.instructions;
+                return true;
+            }
+        }
+    }
+};
+
+// Двоичная трасса ChampSim (без сжатия): записи input_instr по 64 байта -
+// ip, признаки ветвления, регистры, 2 адреса записи и 4 адреса чтения.
+// Поток один, время - номер инструкции
+class ChampsimTraceReader : public TraceReader {
+private:
+    static const size_t RECORD_SIZE = 64;
+    static const size_t DESTINATION_OFFSET = 16;
+    static const size_t SOURCE_OFFSET = 32;
+
+    std::ifstream input;
+    char record[RECORD_SIZE];
+    uint64_t instructions;
+    std::vector<LogEntry> pending;
+    size_t next_pending;
+
+public:
+    explicit ChampsimTraceReader(const std::string& path)
+        : input(path, std::ios::binary), instructions(0), next_pending(0) {}
+
+    bool is_open() const { return static_cast<bool>(input); }
+
+    bool next(LogEntry& entry) override {
+        while (next_pending == pending.size()) {
+            if (!input.read(record, RECORD_SIZE)) {
+                return false;
+            }
+            pending.clear();
+            next_pending = 0;
+            instructions++;
+            uint64_t ip;
+            std::copy(record, record + 8, reinterpret_cast<char*>(&ip));
+            // Сначала чтения, затем записи инструкции
+            for (size_t i = 0; i < 6; ++i) {
+                const bool is_load = i < 4;
+                const size_t offset = is_load ? SOURCE_OFFSET + 8 * i : DESTINATION_OFFSET + 8 * (i - 4);
+                uint64_t address;
+                std::copy(record + offset, record + offset + 8, reinterpret_cast<char*>(&address));
+                if (address == 0) {
+                    continue;
+                }
+                LogEntry access;
+                access.kind = is_load ? AccessKind::Load : AccessKind::Store;
+                access.address = address;
+                access.return_address = ip;
+                access.timestamp = instructions;
+                pending.push_back(access);
+            }
+        }
+        entry = pending[next_pending++];
+        return true;
+    }
+};
+
+// Порядок слияния нескольких трасс
+enum class MergeOrder {
+    Timestamp,     // по времени записей
+    Sequence,      // поочередно по одной записи (round robin)
+    Instructions   // по числу выполненных инструкций (смен PC) в каждой трассе
+};
+
+bool parse_merge_order(const std::string& name, MergeOrder& order) {
+    static const std::pair<const char*, MergeOrder> orders[] = {
+        {"timestamp", MergeOrder::Timestamp},
+        {"sequence", MergeOrder::Sequence},
+        {"round_robin", MergeOrder::Sequence},
+        {"instructions", MergeOrder::Instructions},
+    };
+    for (const auto& it : orders) {
+        if (name == it.first) {
+            order = it.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Слияние трасс нескольких файлов (обычно по файлу на поток). Каждый файл
+// читает свой поток пачками в ограниченную очередь, общий порядок задает
+// k-путевое слияние кучей по времени записи, по номеру записи в файле или по
+// числу инструкций. В режиме смешивания нагрузок (workloads) каждый файл -
+// отдельная нагрузка: время отсчитывается от первой записи файла, адреса и
+// потоки помечаются номером нагрузки (first_workload + номер файла).
+// Файл без времени (первая пачка целиком с нулевым временем) при слиянии по
+// времени ушел бы весь раньше остальных, поэтому тогда все файлы сливаются
+// поочередно
+class MergedTraceReader : public TraceReader {
+private:
+    static const size_t BATCH_SIZE = 4096;
+    static const size_t MAX_QUEUED_BATCHES = 4;
+
+    struct Source {
+        std::unique_ptr<TraceReader> reader;
+        uint64_t thread_id;
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<std::vector<LogEntry>> batches;
+        bool finished;
+        bool stopping;
+        std::vector<LogEntry> batch;
+        size_t position;
+        uint64_t sequence;
+        uint64_t first_timestamp;
+        uint64_t last_pc;
+        uint64_t instructions;
+        std::thread worker;
+    };
+
+    // Ключ слияния и номер файла
+    typedef std::pair<uint64_t, size_t> HeapItem;
+
+    std::vector<std::unique_ptr<Source>> sources;
+    std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<HeapItem>> heap;
+    MergeOrder order;
+    bool file_threads;
+    bool workloads;
+    uint64_t first_workload;
+    size_t untimed;  // файл без времени записей, SIZE_MAX - у всех файлов время есть
+
+    void read_batches(Source& source) {
+        for (;;) {
+            std::vector<LogEntry> batch;
+            batch.reserve(BATCH_SIZE);
+            LogEntry entry;
+            while (batch.size() < BATCH_SIZE && source.reader->next(entry)) {
+                batch.push_back(entry);
+            }
+            const bool last = batch.size() < BATCH_SIZE;
+            std::unique_lock<std::mutex> lock(source.mutex);
+            source.changed.wait(lock, [&] { return source.stopping || source.batches.size() < MAX_QUEUED_BATCHES; });
+            if (source.stopping) {
+                return;
+            }
+            if (!batch.empty()) {
+                source.batches.push_back(std::move(batch));
+            }
+            if (last) {
+                source.finished = true;
+            }
+            source.changed.notify_all();
+            if (last) {
+                return;
+            }
+        }
+    }
+
+    // Текущая запись файла; false - файл закончился
+    bool current(Source& source) {
+        if (source.position < source.batch.size()) {
+            return true;
+        }
+        std::unique_lock<std::mutex> lock(source.mutex);
+        source.changed.wait(lock, [&] { return !source.batches.empty() || source.finished; });
+        if (source.batches.empty()) {
+            return false;
+        }
+        source.batch = std::move(source.batches.front());
+        source.batches.pop_front();
+        source.position = 0;
+        source.changed.notify_all();
+        return true;
+    }
+
+    void push(size_t index) {
+        Source& source = *sources[index];
+        if (!current(source)) {
+            return;
+        }
+        const LogEntry& entry = source.batch[source.position];
+        uint64_t key = source.sequence;
+        if (order == MergeOrder::Timestamp) {
+            if (source.sequence == 0) {
+                source.first_timestamp = workloads ? entry.timestamp : 0;
+            }
+            key = entry.timestamp - std::min(entry.timestamp, source.first_timestamp);
+        } else if (order == MergeOrder::Instructions) {
+            if (source.sequence == 0 || entry.return_address != source.last_pc) {
+                source.instructions++;
+                source.last_pc = entry.return_address;
+            }
+            key = source.instructions;
+        }
+        heap.push(HeapItem(key, index));
+    }
+
+public:
+    MergedTraceReader(std::vector<std::unique_ptr<TraceReader>> readers, MergeOrder order, bool file_threads,
+                      bool workloads, uint64_t first_workload = 0)
+        : order(order), file_threads(file_threads), workloads(workloads), first_workload(first_workload),
+          untimed(SIZE_MAX) {
+        for (size_t i = 0; i < readers.size(); ++i) {
+            std::unique_ptr<Source> source(new Source());
+            source->reader = std::move(readers[i]);
+            source->thread_id = i;
+            source->finished = false;
+            source->stopping = false;
+            source->position = 0;
+            source->sequence = 0;
+            source->first_timestamp = 0;
+            source->last_pc = 0;
+            source->instructions = 0;
+            sources.push_back(std::move(source));
+        }
+        for (auto& source : sources) {
+            Source* raw = source.get();
+            source->worker = std::thread([this, raw] { read_batches(*raw); });
+        }
+        for (size_t i = 0; this->order == MergeOrder::Timestamp && sources.size() > 1 && i < sources.size(); ++i) {
+            Source& source = *sources[i];
+            if (current(source) && std::all_of(source.batch.begin(), source.batch.end(),
+                                               [](const LogEntry& entry) { return entry.timestamp == 0; })) {
+                untimed = i;
+                this->order = MergeOrder::Sequence;
+            }
+        }
+        for (size_t i = 0; i < sources.size(); ++i) {
+            push(i);
+        }
+    }
+
+    ~MergedTraceReader() override {
+        for (auto& source : sources) {
+            std::lock_guard<std::mutex> lock(source->mutex);
+            source->stopping = true;
+            source->changed.notify_all();
+        }
+        for (auto& source : sources) {
+            source->worker.join();
+        }
+    }
+
+    // Файл без времени записей, из-за которого слияние по времени заменено
+    // поочередным; SIZE_MAX - такого нет
+    size_t untimed_source() const { return untimed; }
+
+    bool next(LogEntry& entry) override {
+        if (heap.empty()) {
+            return false;
+        }
+        const size_t index = heap.top().second;
+        heap.pop();
+        Source& source = *sources[index];
+        entry = source.batch[source.position++];
+        if (file_threads) {
+            entry.thread_id = source.thread_id;
+        }
+        if (workloads) {
+            const uint64_t workload = first_workload + source.thread_id;
+            entry.address ^= workload << WORKLOAD_ADDRESS_SHIFT;
+            if (entry.return_address != 0) {
+                entry.return_address ^= workload << WORKLOAD_ADDRESS_SHIFT;
+            }
+            entry.thread_id = (workload << WORKLOAD_THREAD_SHIFT) |
+                              (entry.thread_id & ((1ULL << WORKLOAD_THREAD_SHIFT) - 1));
+        }
+        source.sequence++;
+        push(index);
+        return true;
+    }
+};
+
+class BinaryTraceWriter {
+private:
+    std::ofstream output;
+    std::vector<BinaryTraceRecord> buffer;
+
+public:
+    explicit BinaryTraceWriter(const std::string& path) : output(path, std::ios::binary) {
+        BinaryTraceHeader header;
+        std::copy(BINARY_TRACE_MAGIC, BINARY_TRACE_MAGIC + 8, header.magic);
+        header.version = BINARY_TRACE_VERSION;
+        header.record_size = sizeof(BinaryTraceRecord);
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        buffer.reserve(4096);
+    }
+
+    ~BinaryTraceWriter() { flush(); }
+
+    bool is_open() const { return static_cast<bool>(output); }
+
+    void write(const LogEntry& entry) {
+        BinaryTraceRecord record = {};
+        record.address = entry.address;
+        record.return_address = entry.return_address;
+        record.thread_id = entry.thread_id;
+        record.timestamp = entry.timestamp;
+        record.kind = static_cast<uint8_t>(entry.kind);
+        record.size = entry.size;
+        buffer.push_back(record);
+        if (buffer.size() == buffer.capacity()) {
+            flush();
+        }
+    }
+
+    bool flush() {
+        output.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(BinaryTraceRecord));
+        buffer.clear();
+        return static_cast<bool>(output);
+    }
+};
+
+template <typename Reader>
+std::unique_ptr<TraceReader> open_reader(const std::string& path) {
+    std::unique_ptr<Reader> reader(new Reader(path));
+    if (!reader->is_open()) {
+        std::cerr << "Cannot open trace " << path << "\n";
+        return nullptr;
+    }
+    return reader;
+}
+
+// Открывает трассу; format - text, binary, lackey, drcachesim, champsim
+// или auto (двоичная или текстовая по сигнатуре в начале файла)
+std::unique_ptr<TraceReader> open_trace(const std::string& path, const std::string& format) {
+    std::string actual = format;
+    if (format == "auto") {
+        std::ifstream probe(path, std::ios::binary);
+        char magic[8] = {};
+        probe.read(magic, sizeof(magic));
+        actual = probe && std::equal(magic, magic + 8, BINARY_TRACE_MAGIC) ? "binary" : "text";
+    }
+    if (actual == "text") {
+        return open_reader<TextTraceReader>(path);
+    } else if (actual == "binary") {
+        return open_reader<BinaryTraceReader>(path);
+    } else if (actual == "lackey") {
+        return open_reader<LackeyTraceReader>(path);
+    } else if (actual == "drcachesim") {
+        return open_reader<DrcachesimTraceReader>(path);
+    } else if (actual == "champsim") {
+        return open_reader<ChampsimTraceReader>(path);
+    }
+    std::cerr << "Unknown trace format: " << format << "\n";
+    return nullptr;
+}
+
+// Файлы трассы: сам путь, все файлы каталога или совпадения шаблона glob
+std::vector<std::string> trace_files(const std::string& path) {
+    std::vector<std::string> files;
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+        glob_t matches;
+        if (glob((path + "/*").c_str(), 0, nullptr, &matches) == 0) {
+            for (size_t i = 0; i < matches.gl_pathc; ++i) {
+                if (stat(matches.gl_pathv[i], &info) == 0 && S_ISREG(info.st_mode)) {
+                    files.push_back(matches.gl_pathv[i]);
+                }
+            }
+        }
+        globfree(&matches);
+    } else if (path.find_first_of("*?[") != std::string::npos) {
+        glob_t matches;
+        if (glob(path.c_str(), 0, nullptr, &matches) == 0) {
+            files.assign(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+        }
+        globfree(&matches);
+    } else {
+        files.push_back(path);
+    }
+    return files;
+}
+
+// Элементы списка через запятую (трассы --mix, кванты --interleave_quanta)
+std::vector<std::string> split_list(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// Фильтр записей трассы; условия объединяются по И. Диапазоны полуоткрытые
+struct TraceFilter {
+    std::vector<uint64_t> threads;  // пустой - все потоки
+    uint32_t kinds;                 // битовая маска видов обращений
+    uint64_t address_begin, address_end;
+    uint64_t pc_begin, pc_end;
+    uint64_t record_begin, record_end;  // номера записей исходной трассы
+
+    TraceFilter()
+        : kinds((1u << static_cast<unsigned>(AccessKind::Count)) - 1), address_begin(0), address_end(UINT64_MAX),
+          pc_begin(0), pc_end(UINT64_MAX), record_begin(0), record_end(UINT64_MAX) {}
+
+    bool active() const {
+        return !threads.empty() || kinds != TraceFilter().kinds || address_begin != 0 || address_end != UINT64_MAX ||
+               pc_begin != 0 || pc_end != UINT64_MAX || record_begin != 0 || record_end != UINT64_MAX;
+    }
+};
+
+// Диапазон "начало-конец"; пропущенный конец - до конца адресного пространства
+bool parse_range(const std::string& text, uint64_t& begin, uint64_t& end) {
+    const size_t dash = text.find('-');
+    size_t low = 0, high = SIZE_MAX;
+    if (dash == std::string::npos || !parse_value(text.substr(0, dash), low) ||
+        (dash + 1 < text.size() && !parse_value(text.substr(dash + 1), high)) || low > high) {
+        return false;
+    }
+    begin = low;
+    end = high;
+    return true;
+}
+
+bool parse_trace_filter(const SimulationConfig& config, TraceFilter& filter) {
+    for (const std::string& text : split_list(config.filter_threads)) {
+        size_t thread_id;
+        if (!parse_value(text, thread_id)) {
+            std::cerr << "Invalid thread in filter: " << text << "\n";
+            return false;
+        }
+        filter.threads.push_back(thread_id);
+    }
+    if (!config.filter_kinds.empty()) {
+        filter.kinds = 0;
+        for (const std::string& name : split_list(config.filter_kinds)) {
+            size_t kind = 0;
+            while (kind < static_cast<size_t>(AccessKind::Count) &&
+                   name != access_kind_name(static_cast<AccessKind>(kind))) {
+                kind++;
+            }
+            if (kind == static_cast<size_t>(AccessKind::Count)) {
+                std::cerr << "Unknown access kind in filter: " << name << "\n";
+                return false;
+            }
+            filter.kinds |= 1u << kind;
+        }
+    }
+    const std::pair<const std::string*, std::pair<uint64_t*, uint64_t*>> ranges[] = {
+        {&config.filter_address, {&filter.address_begin, &filter.address_end}},
+        {&config.filter_pc, {&filter.pc_begin, &filter.pc_end}},
+        {&config.filter_records, {&filter.record_begin, &filter.record_end}},
+    };
+    for (const auto& range : ranges) {
+        if (!range.first->empty() && !parse_range(*range.first, *range.second.first, *range.second.second)) {
+            std::cerr << "Invalid filter range: " << *range.first << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Фильтрует записи на этапе декодирования пачками: каждое условие - отдельный
+// проход без ветвлений по пачке, сужающий маску, затем пачка уплотняется.
+// После конца диапазона записей источник больше не читается
+class FilteredTraceReader : public TraceReader {
+private:
+    static const size_t BATCH_SIZE = 4096;
+
+    std::unique_ptr<TraceReader> source;
+    TraceFilter filter;
+    std::vector<LogEntry> batch;
+    std::vector<uint8_t> keep;
+    size_t position;
+    uint64_t record;  // номер следующей записи источника
+
+    // false - источник закончился
+    bool fill() {
+        batch.clear();
+        LogEntry entry;
+        while (batch.size() < BATCH_SIZE && record < filter.record_end && source->next(entry)) {
+            if (record++ >= filter.record_begin) {
+                batch.push_back(entry);
+            }
+        }
+        if (batch.empty()) {
+            return false;
+        }
+        const size_t count = batch.size();
+        keep.assign(count, 1);
+        if (!filter.threads.empty()) {
+            for (size_t i = 0; i < count; ++i) {
+                uint8_t match = 0;
+                for (uint64_t thread_id : filter.threads) {
+                    match |= batch[i].thread_id == thread_id;
+                }
+                keep[i] &= match;
+            }
+        }
+        const uint64_t address_span = filter.address_end - filter.address_begin;
+        const uint64_t pc_span = filter.pc_end - filter.pc_begin;
+        for (size_t i = 0; i < count; ++i) {
+            keep[i] &= (batch[i].address - filter.address_begin) < address_span;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            keep[i] &= (batch[i].return_address - filter.pc_begin) < pc_span;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            keep[i] &= (filter.kinds >> static_cast<unsigned>(batch[i].kind)) & 1u;
+        }
+        size_t kept = 0;
+        for (size_t i = 0; i < count; ++i) {
+            batch[kept] = batch[i];
+            kept += keep[i];
+        }
+        batch.resize(kept);
+        position = 0;
+        return true;
+    }
+
+public:
+    FilteredTraceReader(std::unique_ptr<TraceReader> source, const TraceFilter& filter)
+        : source(std::move(source)), filter(filter), position(0), record(0) {
+        batch.reserve(BATCH_SIZE);
+    }
+
+    bool next(LogEntry& entry) override {
+        while (position == batch.size()) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        entry = batch[position++];
+        return true;
+    }
+};
+
+// Источник записей из конфигурации; несколько файлов сливаются в один поток
+// записей, нагрузки из --mix смешиваются с разными адресными пространствами.
+// first_workload - номер первой нагрузки --mix (для прогона нагрузки в одиночку
+// с тем же адресным пространством, что и в совместном прогоне)
+std::unique_ptr<TraceReader> open_trace_sources(const SimulationConfig& config, size_t first_workload = 0) {
+    const bool mix = !config.mix.empty();
+    const std::vector<std::string> files = mix ? split_list(config.mix) : trace_files(config.trace);
+    if (files.empty()) {
+        std::cerr << "No trace files match " << (mix ? config.mix : config.trace) << "\n";
+        return nullptr;
+    }
+    const std::string& order_name = mix ? config.mix_order : config.trace_merge;
+    MergeOrder order;
+    if (!parse_merge_order(order_name, order)) {
+        std::cerr << "Unknown trace merge order: " << order_name << "\n";
+        return nullptr;
+    }
+    if (files.size() == 1 && !config.trace_file_threads && !mix) {
+        return open_trace(files.front(), config.trace_format);
+    }
+    std::vector<std::unique_ptr<TraceReader>> readers;
+    for (const std::string& file : files) {
+        std::unique_ptr<TraceReader> reader = open_trace(file, config.trace_format);
+        if (!reader) {
+            return nullptr;
+        }
+        readers.push_back(std::move(reader));
+    }
+    std::unique_ptr<MergedTraceReader> merged(
+        new MergedTraceReader(std::move(readers), order, config.trace_file_threads, mix, first_workload));
+    if (merged->untimed_source() != SIZE_MAX) {
+        std::cerr << files[merged->untimed_source()] << " has no timestamps, merging "
+                  << (mix ? "workloads" : "trace files") << " round robin instead of by timestamp\n";
+    }
+    return merged;
+}
+
+// Открывает трассу из конфигурации с фильтрами --filter_*
+std::unique_ptr<TraceReader> open_trace(const SimulationConfig& config, size_t first_workload = 0) {
+    TraceFilter filter;
+    if (!parse_trace_filter(config, filter)) {
+        return nullptr;
+    }
+    std::unique_ptr<TraceReader> reader = open_trace_sources(config, first_workload);
+    if (!reader || !filter.active()) {
+        return reader;
+    }
+    return std::unique_ptr<TraceReader>(new FilteredTraceReader(std::move(reader), filter));
+}
+
+// Перекодирует трассу в двоичный формат
+bool convert_trace(const SimulationConfig& config) {
+    std::unique_ptr<TraceReader> reader = open_trace(config);
+    if (!reader) {
+        return false;
+    }
+    BinaryTraceWriter writer(config.convert_output);
+    if (!writer.is_open()) {
+        std::cerr << "Cannot open " << config.convert_output << " for writing\n";
+        return false;
+    }
+    LogEntry entry;
+    uint64_t records = 0;
+    while (reader->next(entry)) {
+        writer.write(entry);
+        records++;
+    }
+    if (!writer.flush()) {
+        std::cerr << "Cannot write " << config.convert_output << "\n";
+        return false;
+    }
+    std::cout << "Converted " << records << " records to " << config.convert_output << "\n";
+    return true;
+}
+
+
+struct RunInfo {
+    uint64_t accesses;
+    double wall_time_sec;
+
+    double accesses_per_sec() const {
+        return wall_time_sec > 0 ? accesses / wall_time_sec : 0.0;
+    }
+};
+
+// Нагрузка из --mix: итоги совместного запуска и запуска в одиночку
+struct WorkloadResult {
+    std::string trace;
+    WorkloadStats shared;
+    WorkloadStats alone;
+
+    // Оценки замедления от соседей: отношение AMAT и времени работы
+    double amat_slowdown() const { return alone.amat() > 0 ? shared.amat() / alone.amat() : 0.0; }
+    double cycles_slowdown() const {
+        return alone.cycles ? static_cast<double>(shared.cycles) / alone.cycles : 0.0;
+    }
+};
+
+// Прогон трассы при другом чередовании потоков
+struct InterleavingResult {
+    size_t quantum;  // записей потока подряд
+    uint64_t seed;
+    double l2_hit_rate;
+    double l3_hit_rate;
+    size_t invalidations;
+    size_t transfers;
+
+    InterleavingResult() : quantum(1), seed(0), l2_hit_rate(0), l3_hit_rate(0), invalidations(0), transfers(0) {}
+};
+
+
+// level - номер уровня (1..3), по нему выбираются параметры из конфигурации
+bool make_cache_options(const SimulationConfig& config, int level, CacheOptions& options) {
+    const std::string& admission = level == 1 ? config.l1_admission : level == 2 ? config.l2_admission : config.l3_admission;
+    const std::string& partition = level == 1 ? std::string("none") : level == 2 ? config.l2_partition : config.l3_partition;
+    const std::string& index = level == 1 ? config.l1_index : level == 2 ? config.l2_index : config.l3_index;
+    const size_t associativity = level == 1 ? config.l1_associativity
+                               : level == 2 ? config.l2_associativity : config.l3_associativity;
+    const uint64_t seed = config.seed + level - 1;
+
+    if (!parse_index_function(index, options.index_function)) {
+        std::cerr << "Unknown index function: " << index << "\n";
+        return false;
+    }
+    options.set_heatmap = config.set_heatmap;
+    options.same_line_filter = level == 1 && config.l0_filter;
+
+    if (!parse_admission_policy(admission, options.admission)) {
+        std::cerr << "Unknown admission policy: " << admission << "\n";
+        return false;
+    }
+    options.admission_probability = config.admission_probability;
+    options.bip_epsilon = config.bip_epsilon;
+    options.seed = seed;
+
+    if (!parse_partition_mode(partition, options.partition)) {
+        std::cerr << "Unknown partition mode: " << partition << "\n";
+        return false;
+    }
+    if (options.partition == PartitionMode::None) {
+        return true;
+    }
+    if (config.partition_groups == 0 || config.partition_groups > associativity || associativity > 64) {
+        std::cerr << "Way partitioning needs 1.." << associativity
+                  << " groups and associativity of at most 64\n";
+        return false;
+    }
+    options.partition_groups = config.partition_groups;
+    options.partition_epoch = std::max<size_t>(config.partition_epoch, 1);
+
+    // Маски общие для L2 и L3: лишние старшие биты отбрасываются, но у каждой
+    // группы должен остаться хотя бы один путь
+    const uint64_t all_ways = associativity == 64 ? ~0ULL : (1ULL << associativity) - 1;
+    std::stringstream masks(config.partition_masks);
+    std::string mask_text;
+    while (std::getline(masks, mask_text, ',')) {
+        size_t mask = 0;
+        if (!parse_value(mask_text, mask)) {
+            std::cerr << "Invalid way mask: " << mask_text << "\n";
+            return false;
+        }
+        if ((mask & all_ways) == 0) {
+            std::cerr << "Way mask " << mask_text << " has no ways within L" << level << " associativity "
+                      << associativity << "\n";
+            return false;
+        }
+        options.way_masks.push_back(mask & all_ways);
+    }
+    if (!options.way_masks.empty() && options.way_masks.size() != options.partition_groups) {
+        std::cerr << "Expected " << options.partition_groups << " way masks, got " << options.way_masks.size()
+                  << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Файл размеров страниц: строки "начало конец размер" (адреса в десятичной или
+// шестнадцатеричной записи, размер 4K, 2M или 1G), # - комментарий
+bool load_page_size_map(const std::string& path, PageSizeMap& map) {
+    std::ifstream input(path);
+    if (!input) {
+        std::cerr << "Cannot open page size map " << path << "\n";
+        return false;
+    }
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(input, line)) {
+        line_number++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string start_text, end_text, size_text;
+        if (!(fields >> start_text)) {
+            continue;
+        }
+        size_t start, end, size;
+        unsigned shift = 0;
+        if (!(fields >> end_text >> size_text) || !parse_value(start_text, start) || !parse_value(end_text, end) ||
+            !parse_value(size_text, size) || end <= start) {
+            std::cerr << path << ":" << line_number << ": expected \"start end size\"\n";
+            return false;
+        }
+        if (size != (1ULL << 12) && size != (1ULL << 21) && size != (1ULL << 30)) {
+            std::cerr << path << ":" << line_number << ": page size must be 4K, 2M or 1G\n";
+            return false;
+        }
+        while ((1ULL << shift) < size) {
+            shift++;
+        }
+        map.add(start, end, shift);
+    }
+    return true;
+}
+
+// Арена для линий кешей со страницами из --huge_pages
+std::shared_ptr<Arena> make_arena(const SimulationConfig& config) {
+    HugePages huge_pages;
+    if (!parse_huge_pages(config.huge_pages, huge_pages)) {
+        std::cerr << "Unknown huge pages mode: " << config.huge_pages << "\n";
+        return nullptr;
+    }
+    return std::make_shared<Arena>(huge_pages);
+}
+
+// arena - арена для линий кешей, nullptr - новая. Серия прогонов может
+// передавать одну арену, сбрасывая ее после разрушения предыдущей иерархии
+std::unique_ptr<CacheHierarchy> create_hierarchy(const SimulationConfig& config,
+                                                 std::shared_ptr<Arena> arena = nullptr) {
+    CacheOptions l1_options, l2_options, l3_options;
+    if (!make_cache_options(config, 1, l1_options) ||
+        !make_cache_options(config, 2, l2_options) ||
+        !make_cache_options(config, 3, l3_options)) {
+        return nullptr;
+    }
+    if (!arena && !(arena = make_arena(config))) {
+        return nullptr;
+    }
+
+    NucaOptions nuca;
+    nuca.slices = std::max<size_t>(config.l3_slices, 1);
+    nuca.hop_latency = config.hop_latency;
+    nuca.mesh_columns = config.mesh_columns;
+    if (!parse_slice_hash(config.slice_hash, nuca.hash)) {
+        std::cerr << "Unknown slice hash: " << config.slice_hash << "\n";
+        return nullptr;
+    }
+    if (nuca.slices > SlicedCache::max_slices(nuca.hash)) {
+        std::cerr << "Slice hash " << config.slice_hash << " supports at most " << SlicedCache::max_slices(nuca.hash)
+                  << " slices\n";
+        return nullptr;
+    }
+    if (!parse_interconnect(config.interconnect, nuca.topology)) {
+        std::cerr << "Unknown interconnect: " << config.interconnect << "\n";
+        return nullptr;
+    }
+
+    std::unique_ptr<CacheHierarchy> hierarchy(new CacheHierarchy(
+        config.num_cores,
+        config.l1_size, config.l1_line_size, config.l1_associativity,
+        config.l2_size, config.l2_line_size, config.l2_associativity,
+        config.l3_size, config.l3_line_size, config.l3_associativity,
+        l1_options, l2_options, l3_options, nuca, arena
+    ));
+    hierarchy->enable_reuse_distance(config.reuse_distance);
+    hierarchy->enable_coherence(config.coherence);
+
+    LatencyOptions latency;
+    latency.l1 = config.l1_latency;
+    latency.l2 = config.l2_latency;
+    latency.l3 = config.l3_latency;
+    latency.memory = config.memory_latency;
+    hierarchy->set_latencies(latency);
+    hierarchy->enable_pc_stalls(config.pc_stalls);
+
+    MlpOptions mlp;
+    mlp.enabled = config.mlp_model;
+    mlp.issue_window = config.issue_window;
+    mlp.issue_cycles = config.issue_cycles;
+    mlp.l1_mshrs = config.l1_mshrs;
+    mlp.l2_mshrs = config.l2_mshrs;
+    mlp.l3_mshrs = config.l3_mshrs;
+    hierarchy->set_mlp(mlp);
+
+    if (config.dram_model) {
+        DramOptions dram;
+        dram.channels = config.dram_channels;
+        dram.ranks = config.dram_ranks;
+        dram.banks = config.dram_banks;
+        dram.row_size = config.dram_row_size;
+        dram.line_size = config.l3_line_size;
+        dram.t_rcd = config.dram_trcd;
+        dram.t_cas = config.dram_tcas;
+        dram.t_rp = config.dram_trp;
+        dram.t_burst = config.dram_tburst;
+        dram.base_latency = config.dram_base_latency;
+        if (!parse_page_policy(config.dram_page_policy, dram.page_policy)) {
+            std::cerr << "Unknown DRAM page policy: " << config.dram_page_policy << "\n";
+            return nullptr;
+        }
+        if (!parse_dram_mapping(config.dram_mapping, dram.mapping)) {
+            std::cerr << "Unknown DRAM address mapping: " << config.dram_mapping << "\n";
+            return nullptr;
+        }
+        hierarchy->set_dram(dram);
+    }
+
+    if (config.tiered_memory) {
+        TierOptions tiers;
+        tiers.numa_nodes = config.numa_nodes;
+        tiers.node_capacity = config.numa_node_capacity;
+        tiers.node_bandwidth = config.numa_bandwidth;
+        tiers.remote_latency = config.numa_remote_latency;
+        tiers.cxl_capacity = config.cxl_capacity;
+        tiers.cxl_bandwidth = config.cxl_bandwidth;
+        tiers.cxl_latency = config.cxl_latency;
+        tiers.page_size = config.tier_page_size;
+        tiers.line_size = config.l3_line_size;
+        tiers.migration = config.page_migration;
+        tiers.migration_threshold = config.migration_threshold;
+        tiers.migration_epoch = config.migration_epoch;
+        tiers.migration_cost = config.migration_cost;
+        if (!parse_page_placement(config.page_placement, tiers.placement)) {
+            std::cerr << "Unknown page placement: " << config.page_placement << "\n";
+            return nullptr;
+        }
+        hierarchy->set_tiers(tiers);
+    }
+
+    if (config.memory_side_cache) {
+        MemoryCacheOptions memory_cache;
+        memory_cache.size = config.msc_size;
+        memory_cache.block_size = config.msc_block_size;
+        memory_cache.associativity = config.msc_associativity;
+        memory_cache.line_size = config.l3_line_size;
+        memory_cache.hit_latency = config.msc_hit_latency;
+        memory_cache.probe_latency = config.msc_probe_latency;
+        if (!parse_memory_cache_design(config.msc_design, memory_cache.design)) {
+            std::cerr << "Unknown memory-side cache design: " << config.msc_design << "\n";
+            return nullptr;
+        }
+        hierarchy->set_memory_cache(memory_cache);
+    }
+
+    if (config.frame_allocator != "none") {
+        FrameAllocation allocation;
+        if (!parse_frame_allocation(config.frame_allocator, allocation)) {
+            std::cerr << "Unknown frame allocator: " << config.frame_allocator << "\n";
+            return nullptr;
+        }
+        if (config.l1_indexing != "vipt" && config.l1_indexing != "pipt") {
+            std::cerr << "Unknown L1 indexing: " << config.l1_indexing << "\n";
+            return nullptr;
+        }
+        // Цвет страницы - ее номер по модулю числа страниц в одном пути L3
+        const size_t l3_way_bytes = config.l3_size / std::max<size_t>(config.l3_associativity, 1);
+        const size_t colors = config.page_colors ? config.page_colors : std::max<size_t>(l3_way_bytes / 4096, 1);
+        hierarchy->set_physical_map(PhysicalMemoryMap(allocation, config.physical_memory, colors, config.seed),
+                                    config.l1_indexing == "vipt");
+    }
+
+    if (config.icache) {
+        hierarchy->set_icache(config.l1i_size, config.l1i_line_size, config.l1i_associativity,
+                              config.icache_unified, config.icache_prefetch);
+    }
+
+    if (config.tlb) {
+        TlbOptions tlb;
+        tlb.l1_entries = config.dtlb_entries;
+        tlb.l1_associativity = config.dtlb_associativity;
+        tlb.l2_entries = config.stlb_entries;
+        tlb.l2_associativity = config.stlb_associativity;
+        tlb.l2_latency = config.stlb_latency;
+        tlb.walk_latency = config.page_walk_latency;
+        tlb.seed = config.seed;
+        if (!parse_tlb_replacement(config.tlb_replacement, tlb.replacement)) {
+            std::cerr << "Unknown TLB replacement: " << config.tlb_replacement << "\n";
+            return nullptr;
+        }
+        unsigned shift;
+        if (!parse_page_shift(config.page_size, shift)) {
+            std::cerr << "Unknown page size: " << config.page_size << "\n";
+            return nullptr;
+        }
+        PageSizeMap sizes(shift);
+        if (!config.page_size_map.empty() && !load_page_size_map(config.page_size_map, sizes)) {
+            return nullptr;
+        }
+        hierarchy->set_tlb(tlb, sizes);
+        if (config.page_walker) {
+            if (config.page_table_levels != 4 && config.page_table_levels != 5) {
+                std::cerr << "Page table levels must be 4 or 5\n";
+                return nullptr;
+            }
+            hierarchy->set_page_walker(config.page_table_levels, config.pwc_entries);
+        }
+    }
+    return hierarchy;
+}
+
+// Записей трассы в пакете для CacheHierarchy::access_batch()
+const size_t TRACE_BATCH_SIZE = 4096;
+
+// first_workload - номер первой нагрузки --mix, см. open_trace_sources()
+bool run_trace(const SimulationConfig& config, CacheHierarchy& cache_hierarchy, RunInfo& run, bool show_progress,
+               size_t first_workload = 0) {
+    std::unique_ptr<TraceReader> reader = open_trace(config, first_workload);
+    if (!reader) {
+        return false;
+    }
+    std::vector<LogEntry> batch;
+    batch.reserve(TRACE_BATCH_SIZE);
+    LogEntry entry;
+
+    auto start_time = std::chrono::steady_clock::now();
+    uint64_t i = 0; 
+    uint64_t first_timestamp = 0;
+    for (;;) {
+        batch.clear();
+        while (batch.size() < TRACE_BATCH_SIZE && reader->next(entry)) {
+            // Время записи (от первой записи со временем) переводится в самый ранний такт выдачи обращения
+            uint64_t issue = 0;
+            if (entry.timestamp != 0 && config.timestamp_scale > 0) {
+                if (first_timestamp == 0) {
+                    first_timestamp = entry.timestamp;
+                }
+                if (entry.timestamp > first_timestamp) {
+                    issue = static_cast<uint64_t>((entry.timestamp - first_timestamp) * config.timestamp_scale);
+                }
+            }
+            entry.timestamp = issue;
+            batch.push_back(entry);
+        }
+        if (batch.empty()) {
+            break;
+        }
+        cache_hierarchy.access_batch(batch.data(), batch.size());
+        if (show_progress) {
+            for (uint64_t line = (i / 10000 + 1) * 10000; line <= i + batch.size(); line += 10000) {
+                std::cout << "Proccess " << line << " line" << std::endl;
+            }
+        }
+        i += batch.size();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+    run.accesses = i;
+    run.wall_time_sec = elapsed.count();
+    return true;
+}
+
+
+// Версия схемы JSON увеличивается при несовместимых изменениях формата
+const uint64_t RESULTS_SCHEMA_VERSION = 1;
+
+// Трасса, разбитая на потоки (в порядке первого появления потока)
+struct ThreadStream {
+    uint64_t thread_id;
+    std::vector<LogEntry> entries;
+};
+
+bool load_thread_streams(const SimulationConfig& config, std::vector<ThreadStream>& streams) {
+    std::unique_ptr<TraceReader> reader = open_trace(config);
+    if (!reader) {
+        return false;
+    }
+    std::unordered_map<uint64_t, size_t> index;
+    LogEntry entry;
+    while (reader->next(entry)) {
+        auto it = index.emplace(entry.thread_id, streams.size());
+        if (it.second) {
+            streams.push_back(ThreadStream());
+            streams.back().thread_id = entry.thread_id;
+        }
+        streams[it.first->second].entries.push_back(entry);
+    }
+    return true;
+}
+
+// Детерминированное чередование: поток выбирается генератором с затравкой seed
+// и выполняет до quantum записей подряд. Ядра закрепляются в исходном порядке
+// потоков, время из трассы не учитывается
+void replay_interleaving(const std::vector<ThreadStream>& streams, size_t quantum, uint64_t seed,
+                         CacheHierarchy& hierarchy) {
+    std::vector<size_t> positions(streams.size(), 0);
+    std::vector<size_t> runnable;
+    for (size_t i = 0; i < streams.size(); ++i) {
+        hierarchy.bind_thread(streams[i].thread_id);
+        if (!streams[i].entries.empty()) {
+            runnable.push_back(i);
+        }
+    }
+    std::mt19937_64 rng(seed);
+    while (!runnable.empty()) {
+        const size_t pick = rng() % runnable.size();
+        const ThreadStream& stream = streams[runnable[pick]];
+        size_t& position = positions[runnable[pick]];
+        const size_t end = std::min(position + quantum, stream.entries.size());
+        for (; position < end; ++position) {
+            const LogEntry& entry = stream.entries[position];
+            hierarchy.access(entry.address, stream.thread_id, entry.return_address, entry.kind);
+        }
+        if (position == stream.entries.size()) {
+            runnable[pick] = runnable.back();
+            runnable.pop_back();
+        }
+    }
+}
+
+// Прогоняет трассу при всех сочетаниях кванта из --interleave_quanta и
+// --interleavings затравок, параллельно в --interleave_jobs потоках
+bool run_interleavings(const SimulationConfig& config, std::vector<InterleavingResult>& results) {
+    std::vector<size_t> quanta;
+    for (const std::string& text : split_list(config.interleave_quanta)) {
+        size_t quantum;
+        if (!parse_value(text, quantum) || quantum == 0) {
+            std::cerr << "Invalid interleaving quantum: " << text << "\n";
+            return false;
+        }
+        quanta.push_back(quantum);
+    }
+    std::vector<ThreadStream> streams;
+    if (!load_thread_streams(config, streams)) {
+        return false;
+    }
+
+    for (size_t quantum : quanta) {
+        for (size_t run = 0; run < config.interleavings; ++run) {
+            InterleavingResult result;
+            result.quantum = quantum;
+            result.seed = config.seed + run;
+            results.push_back(result);
+        }
+    }
+
+    size_t jobs = config.interleave_jobs ? config.interleave_jobs : std::thread::hardware_concurrency();
+    jobs = std::max<size_t>(1, std::min(jobs, results.size()));
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    auto worker = [&] {
+        // Своя арена у каждого рабочего потока; иерархия прошлого прогона к
+        // началу следующего уже разрушена, и ее память переиспользуется
+        std::shared_ptr<Arena> arena = make_arena(config);
+        if (!arena) {
+            failed = true;
+            return;
+        }
+        for (size_t i = next++; i < results.size(); i = next++) {
+            arena->reset();
+            std::unique_ptr<CacheHierarchy> hierarchy = create_hierarchy(config, arena);
+            if (!hierarchy) {
+                failed = true;
+                return;
+            }
+            InterleavingResult& result = results[i];
+            replay_interleaving(streams, result.quantum, result.seed, *hierarchy);
+            result.l2_hit_rate = hierarchy->l2_statistics().hit_rate();
+            result.l3_hit_rate = hierarchy->l3_statistics().hit_rate();
+            hierarchy->coherence_statistics(result.invalidations, result.transfers);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < jobs; ++i) {
+        workers.emplace_back(worker);
+    }
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+    return !failed;
+}
+
+// Среднее, стандартное отклонение, минимум и максимум метрики по прогонам с квантом quantum
+template <typename Metric>
+void summarize_interleavings(const std::vector<InterleavingResult>& results, size_t quantum, Metric metric,
+                             double& mean, double& stddev, double& low, double& high) {
+    std::vector<double> values;
+    for (const InterleavingResult& result : results) {
+        if (result.quantum == quantum) {
+            values.push_back(metric(result));
+        }
+    }
+    mean = stddev = low = high = 0.0;
+    if (values.empty()) {
+        return;
+    }
+    low = *std::min_element(values.begin(), values.end());
+    high = *std::max_element(values.begin(), values.end());
+    for (double value : values) {
+        mean += value;
+    }
+    mean /= values.size();
+    for (double value : values) {
+        stddev += (value - mean) * (value - mean);
+    }
+    stddev = std::sqrt(stddev / values.size());
+}
+
+// Кванты в порядке первого появления
+std::vector<size_t> interleaving_quanta(const std::vector<InterleavingResult>& results) {
+    std::vector<size_t> quanta;
+    for (const InterleavingResult& result : results) {
+        if (std::find(quanta.begin(), quanta.end(), result.quantum) == quanta.end()) {
+            quanta.push_back(result.quantum);
+        }
+    }
+    return quanta;
+}
+
+const std::pair<const char*, double (*)(const InterleavingResult&)> INTERLEAVING_METRICS[] = {
+    {"l2_hit_rate", [](const InterleavingResult& result) { return result.l2_hit_rate; }},
+    {"l3_hit_rate", [](const InterleavingResult& result) { return result.l3_hit_rate; }},
+    {"invalidations", [](const InterleavingResult& result) { return static_cast<double>(result.invalidations); }},
+    {"transfers", [](const InterleavingResult& result) { return static_cast<double>(result.transfers); }},
+};
+
+void print_interleavings(const std::vector<InterleavingResult>& results) {
+    std::cout << "Interleavings (mean +- stddev [min, max]):\n";
+    for (size_t quantum : interleaving_quanta(results)) {
+        std::cout << "quantum " << quantum << ":";
+        for (const auto& metric : INTERLEAVING_METRICS) {
+            double mean, stddev, low, high;
+            summarize_interleavings(results, quantum, metric.second, mean, stddev, low, high);
+            std::cout << " " << metric.first << " " << mean << " +- " << stddev << " [" << low << ", " << high << "]";
+        }
+        std::cout << "\n";
+    }
+}
+
+// Прогоняет каждую нагрузку из --mix в одиночку с той же конфигурацией и тем же
+// адресным пространством, что и в совместном прогоне: иначе при xor/skewed
+// индексах и хешировании слайсов ее линии попали бы в другие сеты и слайсы
+bool run_workloads_alone(const SimulationConfig& config, const CacheHierarchy& shared,
+                         std::vector<WorkloadResult>& results) {
+    const std::vector<std::string> traces = split_list(config.mix);
+    std::shared_ptr<Arena> arena = make_arena(config);
+    if (!arena) {
+        return false;
+    }
+    for (size_t i = 0; i < traces.size(); ++i) {
+        SimulationConfig alone_config = config;
+        alone_config.mix = traces[i];
+        arena->reset();  // иерархия прошлой нагрузки уже разрушена
+        std::unique_ptr<CacheHierarchy> alone = create_hierarchy(alone_config, arena);
+        RunInfo alone_run;
+        if (!alone || !run_trace(alone_config, *alone, alone_run, false, i)) {
+            return false;
+        }
+        WorkloadResult result;
+        result.trace = traces[i];
+        result.shared = shared.workload_statistics(i);
+        result.alone = alone->workload_statistics(i);
+        results.push_back(result);
+    }
+    return true;
+}
+
+void print_workloads(const std::vector<WorkloadResult>& workloads) {
+    std::cout << "Workloads vs alone:\n";
+    for (size_t i = 0; i < workloads.size(); ++i) {
+        const WorkloadResult& workload = workloads[i];
+        std::cout << i << " " << workload.trace << ": AMAT " << workload.shared.amat() << " (alone "
+                  << workload.alone.amat() << "), L3 misses " << workload.shared.l3_misses << " (alone "
+                  << workload.alone.l3_misses << "), slowdown " << workload.amat_slowdown() << " AMAT, "
+                  << workload.cycles_slowdown() << " cycles\n";
+    }
+}
+
+// baseline - прогон той же трассы без политик допуска (может отсутствовать),
+// workloads - итоги нагрузок из --mix (пустой без смешивания),
+// interleavings - прогоны при других чередованиях потоков (пустой без анализа)
+bool write_results_json(const SimulationConfig& config, const CacheHierarchy& hierarchy, const RunInfo& run,
+                        const CacheHierarchy* baseline, const std::vector<WorkloadResult>& workloads,
+                        const std::vector<InterleavingResult>& interleavings) {
+    std::ofstream out(config.json_output);
+    if (!out) {
+        std::cerr << "Cannot open " << config.json_output << " for writing\n";
+        return false;
+    }
+
+    JsonWriter json(out);
+    json.begin_object();
+    json.value("schema_version", RESULTS_SCHEMA_VERSION);
+
+    json.begin_object("config");
+    config.visit([&](const std::string& name, const auto& field) {
+        json.value(name, field);
+    });
+    json.end_object();
+
+    json.begin_object("run");
+    json.value("accesses", run.accesses);
+    json.value("wall_time_sec", run.wall_time_sec);
+    json.value("accesses_per_sec", run.accesses_per_sec());
+    json.end_object();
+
+    hierarchy.write_json(json);
+
+    if (baseline) {
+        const std::pair<std::string, std::pair<CacheStats, CacheStats> > levels[] = {
+            {"l1", {hierarchy.l1_statistics(), baseline->l1_statistics()}},
+            {"l2", {hierarchy.l2_statistics(), baseline->l2_statistics()}},
+            {"l3", {hierarchy.l3_statistics(), baseline->l3_statistics()}},
+        };
+        json.begin_object("admission_baseline");
+        for (const auto& level : levels) {
+            json.begin_object(level.first);
+            json.value("lru_hits", level.second.second.hits);
+            json.value("lru_misses", level.second.second.misses);
+            json.value("lru_hit_rate", level.second.second.hit_rate());
+            json.value("hit_rate_delta", level.second.first.hit_rate() - level.second.second.hit_rate());
+            json.end_object();
+        }
+        json.end_object();
+    }
+
+    if (!workloads.empty()) {
+        json.begin_array("workloads");
+        for (const WorkloadResult& workload : workloads) {
+            json.begin_object();
+            json.value("trace", workload.trace);
+            json.value("threads", workload.shared.threads);
+            json.value("accesses", workload.shared.accesses);
+            json.value("amat", workload.shared.amat());
+            json.value("alone_amat", workload.alone.amat());
+            json.value("l3_misses", workload.shared.l3_misses);
+            json.value("alone_l3_misses", workload.alone.l3_misses);
+            json.value("cycles", workload.shared.cycles);
+            json.value("alone_cycles", workload.alone.cycles);
+            json.value("amat_slowdown", workload.amat_slowdown());
+            json.value("cycles_slowdown", workload.cycles_slowdown());
+            json.end_object();
+        }
+        json.end_array();
+    }
+
+    if (!interleavings.empty()) {
+        json.begin_array("interleavings");
+        for (size_t quantum : interleaving_quanta(interleavings)) {
+            json.begin_object();
+            json.value("quantum", quantum);
+            for (const auto& metric : INTERLEAVING_METRICS) {
+                double mean, stddev, low, high;
+                summarize_interleavings(interleavings, quantum, metric.second, mean, stddev, low, high);
+                json.begin_object(metric.first);
+                json.value("mean", mean);
+                json.value("stddev", stddev);
+                json.value("min", low);
+                json.value("max", high);
+                json.end_object();
+            }
+            json.begin_array("runs");
+            for (const InterleavingResult& result : interleavings) {
+                if (result.quantum != quantum) {
+                    continue;
+                }
+                json.begin_object();
+                json.value("seed", result.seed);
+                json.value("l2_hit_rate", result.l2_hit_rate);
+                json.value("l3_hit_rate", result.l3_hit_rate);
+                json.value("invalidations", result.invalidations);
+                json.value("transfers", result.transfers);
+                json.end_object();
+            }
+            json.end_array();
+            json.end_object();
+        }
+        json.end_array();
+    }
+
+    json.end_object();
+    out << "\n";
+    return true;
+}
+
+// Дописывает одну строку с конфигурацией и итоговыми счетчиками.
+// Заголовок пишется, только если файл пуст, так что свип может дописывать в один файл
+bool append_results_csv(const SimulationConfig& config, const CacheHierarchy& hierarchy, const RunInfo& run,
+                        const CacheHierarchy* baseline) {
+    std::vector<std::pair<std::string, std::string> > columns;
+    config.visit([&](const std::string& name, const auto& field) {
+        columns.emplace_back(name, to_text(field));
+    });
+
+    columns.emplace_back("accesses", to_text(static_cast<size_t>(run.accesses)));
+    columns.emplace_back("wall_time_sec", to_text(run.wall_time_sec));
+    columns.emplace_back("accesses_per_sec", to_text(run.accesses_per_sec()));
+
+    uint64_t accesses, latency_cycles, stall_cycles;
+    hierarchy.total_latency(accesses, latency_cycles, stall_cycles);
+    columns.emplace_back("amat", to_text(hierarchy.amat()));
+    columns.emplace_back("stall_cycles", to_text(static_cast<size_t>(stall_cycles)));
+
+    const std::pair<std::string, CacheStats> levels[] = {
+        {"l1", hierarchy.l1_statistics()},
+        {"l2", hierarchy.l2_statistics()},
+        {"l3", hierarchy.l3_statistics()},
+    };
+    const CacheStats baseline_levels[] = {
+        baseline ? baseline->l1_statistics() : CacheStats(),
+        baseline ? baseline->l2_statistics() : CacheStats(),
+        baseline ? baseline->l3_statistics() : CacheStats(),
+    };
+    for (size_t i = 0; i < 3; ++i) {
+        const std::string& name = levels[i].first;
+        const CacheStats& stats = levels[i].second;
+        columns.emplace_back(name + "_hits", to_text(stats.hits));
+        columns.emplace_back(name + "_misses", to_text(stats.misses));
+        columns.emplace_back(name + "_evictions", to_text(stats.evictions));
+        columns.emplace_back(name + "_hit_rate", to_text(stats.hit_rate()));
+        columns.emplace_back(name + "_dead_block_ratio", to_text(stats.dead_block_ratio()));
+        columns.emplace_back(name + "_bypass_rate", to_text(stats.bypass_rate()));
+        // Без сравнительного прогона колонка остается пустой, чтобы строки свипа совпадали по схеме
+        columns.emplace_back(name + "_hit_rate_delta",
+                             baseline ? to_text(stats.hit_rate() - baseline_levels[i].hit_rate()) : "");
+    }
+
+    bool need_header = true;
+    {
+        std::ifstream existing(config.csv_output);
+        need_header = !existing || existing.peek() == std::ifstream::traits_type::eof();
+    }
+
+    std::ofstream out(config.csv_output, std::ios::app);
+    if (!out) {
+        std::cerr << "Cannot open " << config.csv_output << " for writing\n";
+        return false;
+    }
+
+    // Значения с запятыми или кавычками экранируются по правилам CSV
+    auto csv_field = [](const std::string& text) {
+        if (text.find_first_of(",\"\n") == std::string::npos) {
+            return text;
+        }
+        std::string quoted = "\"";
+        for (char c : text) {
+            quoted += c;
+            if (c == '"') {
+                quoted += '"';
+            }
+        }
+        return quoted + "\"";
+    };
+
+    if (need_header) {
+        for (size_t i = 0; i < columns.size(); ++i) {
+            out << (i ? "," : "") << csv_field(columns[i].first);
+        }
+        out << "\n";
+    }
+    for (size_t i = 0; i < columns.size(); ++i) {
+        out << (i ? "," : "") << csv_field(columns[i].second);
+    }
+    out << "\n";
+    return true;
+}
+
+
+// Скорость моделирования одного кеша с геометрией L3 для каждой функции индекса.
+// Трасса заранее читается в память, чтобы замер не включал разбор текста
+bool run_index_benchmark(const SimulationConfig& config) {
+    std::unique_ptr<TraceReader> reader = open_trace(config);
+    if (!reader) {
+        return false;
+    }
+    std::vector<uint64_t> addresses;
+    LogEntry entry;
+    while (reader->next(entry)) {
+        addresses.push_back(entry.address);
+    }
+    if (addresses.empty()) {
+        return true;
+    }
+
+    // Линии кеша - из арены со страницами --huge_pages, как в обычном прогоне;
+    // кеш каждой функции разрушается до следующей, так что арена сбрасывается
+    std::shared_ptr<Arena> arena = make_arena(config);
+    if (!arena) {
+        return false;
+    }
+    const size_t repeats = std::max<size_t>(1, 10000000 / addresses.size());
+    const char* functions[] = {"modulo", "xor", "prime", "skewed"};
+    std::cout << "Index function benchmark (" << addresses.size() * repeats << " accesses each):\n";
+    for (const char* function : functions) {
+        arena->reset();
+        CacheOptions options;
+        parse_index_function(function, options.index_function);
+        options.arena = arena.get();
+        Cache cache(config.l3_size, config.l3_line_size, config.l3_associativity, true, options);
+
+        auto start_time = std::chrono::steady_clock::now();
+        for (size_t repeat = 0; repeat < repeats; ++repeat) {
+            for (uint64_t address : addresses) {
+                cache.access(address);
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+        std::cout << "  " << std::setw(7) << function << ": "
+                  << static_cast<uint64_t>(addresses.size() * repeats / elapsed.count()) << " accesses/sec, hit rate "
+                  << cache.statistics().hit_rate() << "\n";
+    }
+    return true;
+}
+
+
+// Встроенные сценарии с заранее известным результатом. Возвращает false, если
+// хотя бы один из них не выполнен
+bool run_self_test() {
+    bool passed = true;
+    auto check = [&](const char* name, bool ok) {
+        std::cout << "  " << name << ": " << (ok ? "ok" : "FAILED") << "\n";
+        passed &= ok;
+    };
+    std::cout << "Self test:\n";
+
+    // VIPT L1 с путем 32 КБ (больше страницы) и случайными кадрами: грязная
+    // линия, вытесненная обращениями с тем же виртуальным индексом, пишется
+    // по своему физическому адресу
+    {
+        PhysicalMemoryMap physical(FrameAllocation::Random, 1ULL << 30);
+        CacheOptions options;
+        options.virtual_index = true;
+        Cache l1(64 * 1024, 64, 2, false, options);
+        const uint64_t way_bytes = 32 * 1024;
+        const uint64_t stored = 0x7f0000005040ULL;
+        l1.access_indexed(physical.translate(stored), stored, true, 0, 0, true);
+        for (uint64_t i = 1; i <= 2; ++i) {
+            l1.access_indexed(physical.translate(stored + i * way_bytes), stored + i * way_bytes);
+        }
+        uint64_t victim = 0;
+        check("vipt_writeback", l1.take_writeback(victim) && victim == physical.translate(stored) / 64 * 64);
+    }
+
+    // Разные физические линии с одинаковым виртуальным индексом и одинаковыми
+    // битами физического адреса вне индекса - разные линии, а не попадание
+    {
+        CacheOptions options;
+        options.virtual_index = true;
+        Cache l1(64 * 1024, 64, 2, false, options);
+        const uint64_t virtual_address = 0x7f0000003040ULL;
+        const uint64_t first = 0x12345040ULL;
+        l1.access_indexed(first, virtual_address);
+        check("vipt_no_alias", !l1.access_indexed(first ^ 0x4000, virtual_address));
+    }
+    return passed;
+}
+
+
+int main(int argc, char** argv) {
+    SimulationConfig config;
+    if (!parse_arguments(argc, argv, config)) {
+        return 1;
+    }
+    if (config.benchmark_index) {
+        return run_index_benchmark(config) ? 0 : 1;
+    }
+    if (config.self_test) {
+        return run_self_test() ? 0 : 1;
+    }
+    if (!config.convert_output.empty()) {
+        return convert_trace(config) ? 0 : 1;
+    }
+
+    std::unique_ptr<CacheHierarchy> cache_hierarchy = create_hierarchy(config);
+    RunInfo run;
+    if (!cache_hierarchy || !run_trace(config, *cache_hierarchy, run, true)) {
+        return 1;
+    }
+
+    cache_hierarchy->print_statistics();
+
+    // Сравнительный прогон с обычным LRU на всех уровнях
+    std::unique_ptr<CacheHierarchy> baseline;
+    if (config.admission_compare) {
+        SimulationConfig lru_config = config;
+        lru_config.l1_admission = lru_config.l2_admission = lru_config.l3_admission = "none";
+        lru_config.reuse_distance = false;
+        baseline = create_hierarchy(lru_config);
+        RunInfo baseline_run;
+        if (!baseline || !run_trace(lru_config, *baseline, baseline_run, false)) {
+            return 1;
+        }
+        const std::pair<const char*, std::pair<CacheStats, CacheStats> > levels[] = {
+            {"L1", {cache_hierarchy->l1_statistics(), baseline->l1_statistics()}},
+            {"L2", {cache_hierarchy->l2_statistics(), baseline->l2_statistics()}},
+            {"L3", {cache_hierarchy->l3_statistics(), baseline->l3_statistics()}},
+        };
+        std::cout << "Admission vs LRU:\n";
+        for (const auto& level : levels) {
+            std::cout << level.first << ": hit rate " << level.second.first.hit_rate()
+                      << " (LRU " << level.second.second.hit_rate() << "), bypass rate "
+                      << level.second.first.bypass_rate() << "\n";
+        }
+    }
+
+    // Замедление нагрузок из --mix относительно запуска в одиночку
+    std::vector<WorkloadResult> workloads;
+    if (!config.mix.empty()) {
+        if (!run_workloads_alone(config, *cache_hierarchy, workloads)) {
+            return 1;
+        }
+        print_workloads(workloads);
+    }
+
+    // Чувствительность к чередованию потоков
+    std::vector<InterleavingResult> interleavings;
+    if (config.interleavings > 0) {
+        if (!run_interleavings(config, interleavings)) {
+            return 1;
+        }
+        print_interleavings(interleavings);
+    }
+
+    if (!config.json_output.empty() &&
+        !write_results_json(config, *cache_hierarchy, run, baseline.get(), workloads, interleavings)) {
+        return 1;
+    }
+    if (!config.csv_output.empty() && !append_results_csv(config, *cache_hierarchy, run, baseline.get())) {
+        return 1;
+    }
+    if (!config.heatmap_output.empty()) {
+        std::ofstream heatmap(config.heatmap_output);
+        if (!heatmap) {
+            std::cerr << "Cannot open " << config.heatmap_output << " for writing\n";
+            return 1;
+        }
+        cache_hierarchy->write_heatmap_csv(heatmap);
+    }
     return 0;
 }